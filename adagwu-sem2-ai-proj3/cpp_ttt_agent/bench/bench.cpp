@@ -0,0 +1,213 @@
+#include "ttt_agent/ttt_agent2.hpp"
+#include "ttt_agent/ybwc.hpp"
+
+#include <new>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+using namespace ttt_agent;
+
+// microbenchmarks of board primitives and fixed depth searches on the saved positions,
+// grouped by (n, m). every number is min / median / p99 over `samples` timed runs.
+// exits with 1 when a search (after the first one of its player) allocates, or a search driver misses
+// a win in one, so it can guard both.
+// usage: ttt_bench [positions file] [samples] [search depth]
+
+volatile long long sink = 0;
+
+// every heap allocation of the process is counted: searches after the first one of a player must not make any.
+// sized delete is left to the library, which calls this one (a replaced inline copy of it makes gcc warn
+// about `free()` of memory from `new`).
+std::atomic<long long> allocations{0};
+
+void *operator new(size_t size) {
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void *p = std::malloc(size ? size : 1)) return p;
+	throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { std::free(p); }
+
+struct Timing { double min, median, p99; };
+
+Timing summary(std::vector<double> values) {
+	std::sort(values.begin(), values.end());
+	size_t p99 = std::min(values.size() - 1, size_t(values.size() * 0.99));
+	return {values.front(), values[values.size() / 2], values[p99]};
+}
+
+// ns per operation of `body` (one call does `ops` of them). calls are batched so one sample takes
+// at least a millisecond, the first batch only warms up.
+template<class F> Timing measure(int samples, long long ops, F body) {
+	using clock = std::chrono::high_resolution_clock;
+	int batch = 1;
+	while (true) {
+		auto start = clock::now();
+		for (int k = 0; k < batch; k++) body();
+		if (clock::now() - start >= std::chrono::milliseconds(1) || batch >= (1 << 20)) break;
+		batch <<= 1;
+	}
+	std::vector<double> ns;
+	for (int s = 0; s < samples; s++) {
+		auto start = clock::now();
+		for (int k = 0; k < batch; k++) body();
+		ns.push_back(std::chrono::duration<double, std::nano>(clock::now() - start).count() / (double(batch) * std::max(ops, 1LL)));
+	}
+	return summary(ns);
+}
+
+void print(const std::string &name, const Timing &t, const std::string &unit = "ns/op") {
+	std::cout << "  " << std::left << std::setw(18) << name << std::right << std::fixed << std::setprecision(1)
+		<< std::setw(12) << t.min << std::setw(12) << t.median << std::setw(12) << t.p99 << "  " << unit << "\n";
+}
+
+char toMove(const Board &B) {
+	int xs = 0, os = 0;
+	for (int i = 0; i < B.n; i++) for (int j = 0; j < B.n; j++) xs += B.at(i, j) == X, os += B.at(i, j) == O;
+	return os > xs ? X : O;
+}
+
+// false when searches allocated.
+bool benchGroup(std::vector<Board> boards, int samples, int depth) {
+	const Board &first = boards[0];
+	std::cout << "\nn " << first.n << ", m " << first.m << ": " << boards.size() << " positions"
+		<< std::setw(13) << "min" << std::setw(12) << "median" << std::setw(12) << "p99" << "\n";
+	std::vector<std::vector<pii> > empty(boards.size()), taken(boards.size());
+	long long empties = 0, stones = 0;
+	for (size_t b = 0; b < boards.size(); b++) {
+		empty[b] = boards[b].getCandidateMoves();
+		for (int i = 0; i < boards[b].n; i++) {
+			for (int j = 0; j < boards[b].n; j++) if (boards[b].at(i, j) != E) taken[b].push_back({i, j});
+		}
+		empties += empty[b].size();
+		stones += taken[b].size();
+	}
+	const long long count = boards.size();
+
+	print("make/undo", measure(samples, empties, [&] {
+		for (size_t b = 0; b < boards.size(); b++) {
+			for (auto &move: empty[b]) boards[b].make(move, X), boards[b].undo(move);
+		}
+		sink += boards[0].hash;
+	}));
+	print("isMoveWin", measure(samples, stones, [&] {
+		long long wins = 0;
+		for (size_t b = 0; b < boards.size(); b++) for (auto &move: taken[b]) wins += boards[b].isMoveWin(move);
+		sink += wins;
+	}));
+	print("checkAllDangers", measure(samples, stones, [&] {
+		long long danger = 0;
+		for (size_t b = 0; b < boards.size(); b++) for (auto &move: taken[b]) danger += boards[b].checkAllDangers(move);
+		sink += danger;
+	}));
+	print("getCandidateMoves", measure(samples, count, [&] {
+		long long moves = 0;
+		for (auto &B: boards) moves += B.getCandidateMoves().size();
+		sink += moves;
+	}));
+	print("boardKey", measure(samples, count, [&] {
+		long long size = 0;
+		for (auto &B: boards) size += B.boardKey().size();
+		sink += size;
+	}));
+
+	// fixed depth alpha-beta from a cleared table, the same work every run.
+	playerData p{first};
+	p.tt = std::make_shared<TransTable>(16);
+	p.threatShare = 0;
+	std::vector<double> ms;
+	long long nodes = 0, allocated[2] = {0, 0};
+	auto searchAll = [&](int threads) {
+		nodes = 0;
+		long long before = allocations.load();
+		for (auto &B: boards) {
+			p.B = B;
+			p.car = toMove(B);
+			p.opp = p.car == X ? O : X;
+			p.mylastmove = {-1, -1};
+			p.depth = depth;
+			p.tt->clear();
+			p.order.clear();
+			if (threads > 1) minimaxBestThreading(p, true, threads, INT_MAX / 4);
+			else minimaxBest(p, true, INT_MAX / 4);
+			nodes += p.nodes;
+		}
+		allocated[threads > 1] = allocations.load() - before;
+	};
+	// the first pass makes the player's buffers, so it is not timed nor counted.
+	searchAll(1);
+	for (int s = 0; s < samples; s++) {
+		auto start = std::chrono::high_resolution_clock::now();
+		searchAll(1);
+		ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / count);
+	}
+	Timing search = summary(ms);
+	print("search depth " + std::to_string(depth), search, "ms/position");
+	std::cout << "  " << std::left << std::setw(18) << "nodes/s" << std::right << std::setw(12) << (long long)(nodes / count / (search.median / 1000))
+		<< "  (" << nodes / count << " nodes/position)\n";
+	// second threaded pass, after the first one started the helper threads.
+	searchAll(2);
+	searchAll(2);
+	// totals over the group, an average would round a rare allocation down to 0.
+	std::cout << "  " << std::left << std::setw(18) << "allocations" << std::right << std::setw(12) << allocated[0]
+		<< "  in " << count << " searches (1 thread), " << allocated[1] << " (2 threads)\n";
+	return !allocated[0] && !allocated[1];
+}
+
+// X has a four made several moves ago (O moved last, so `quickMove` does not see it):
+// every driver has to finish it at 0:4.
+bool finishesFour() {
+	Board B(10, 5);
+	const char *rows[] = {"XXXX------", "----------", "-----O----", "----------", "----O-----", "---O------"};
+	for (int i = 0; i < 6; i++) for (int j = 0; j < 10; j++) if (rows[i][j] != '-') B.make({i, j}, rows[i][j]);
+	B.make({9, 9}, O);
+	bool ok = true;
+	for (int driver = 0; driver < 3; driver++) {
+		playerData p{B};
+		p.tt = std::make_shared<TransTable>(1);
+		p.car = X;
+		p.opp = O;
+		p.threatShare = 0;
+		pii move = driver == 0 ? minimaxBest(p, true, 1000) : driver == 1 ? minimaxBestThreading(p, true, 2, 1000) : ybwcBest(p, 2, 1000);
+		if (move.i == 0 && move.j == 4) continue;
+		const char *names[] = {"minimaxBest", "minimaxBestThreading", "ybwcBest"};
+		std::cout << names[driver] << " played " << move.i << ":" << move.j << " instead of the five at 0:4\n";
+		ok = false;
+	}
+	return ok;
+}
+
+int main(int argc, char **argv) {
+	std::string path = argc > 1 ? argv[1] : TTT_BENCH_POSITIONS;
+	int samples = argc > 2 ? std::max(std::stoi(argv[2]), 1) : 25, depth = argc > 3 ? std::stoi(argv[3]) : 4;
+
+	// groups of boards with the same (n, m), in file order.
+	std::vector<std::vector<Board> > groups;
+	std::ifstream file(path);
+	std::string line;
+	while (std::getline(file, line)) {
+		if (line.empty() || line[0] == '#') continue;
+		int n = 0, m = 0;
+		if (sscanf(line.c_str(), "%d %d", &n, &m) != 2 || n < 1 || n > MAX_N || m < 1 || m > n) continue;
+		Board B(n, m);
+		for (int i = 0; i < n && std::getline(file, line); i++) {
+			for (int j = 0; j < n && j < (int)line.size(); j++) if (line[j] == X || line[j] == O) B.make({i, j}, line[j]);
+		}
+		if (groups.empty() || groups.back()[0].n != n || groups.back()[0].m != m) groups.emplace_back();
+		groups.back().push_back(B);
+	}
+	if (groups.empty()) {
+		std::cout << "no positions in " << path << "\n";
+		return -1;
+	}
+	if (!finishesFour()) return 1;
+	std::cout << "positions: " << path << ", samples: " << samples << "\n";
+	bool clean = true;
+	for (auto &group: groups) clean = benchGroup(group, samples, depth) && clean;
+	if (!clean) {
+		std::cout << "\nsearches allocated memory\n";
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,176 @@
+#pragma once
+#include "ttt_agent2.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <functional>
+#include <unordered_set>
+#if defined(_WIN32)
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ttt_agent {
+	// book file: header, then entries sorted by key. keys are canonical (see `Board::canonical()`) with
+	// side to move mixed in, moves are cells in that canonical orientation.
+	struct BookHeader { char magic[4]; int32_t n, m; uint32_t count; };
+	struct BookEntry { uint64_t key; int32_t score; int16_t move, depth; };
+	static_assert(sizeof(BookHeader) == 16 && sizeof(BookEntry) == 16, "book layout is fixed");
+	const char BOOK_MAGIC[4] = {'T', 'T', 'T', 'B'};
+	// replies expanded from every book position by the builder.
+	const int BOOK_WIDTH = 3;
+
+	// key of position `B` with `tomove` to move, `sym` receives orientation of stored moves.
+	inline uint64_t bookKey(const Board &B, char tomove, int &sym) {
+		sym = B.canonical();
+		return B.symHash[sym] ^ (tomove == X ? zobrist.side : 0);
+	}
+
+	// read only book, memory mapped (read into memory on windows). lookups are binary searches.
+	struct OpeningBook {
+		const BookEntry *entries = nullptr;
+		size_t count = 0;
+		int n = 0, m = 0;
+
+		OpeningBook() = default;
+		OpeningBook(const OpeningBook &) = delete;
+		OpeningBook &operator=(const OpeningBook &) = delete;
+		~OpeningBook() { close(); }
+
+		// false if file is missing or is not a book.
+		bool open(const std::string &path) {
+			close();
+		#if defined(_WIN32)
+			std::ifstream file(path, std::ios::binary);
+			if (!file) return false;
+			buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+			const char *data = buffer.data();
+			size_t size = buffer.size();
+		#else
+			int fd = ::open(path.c_str(), O_RDONLY);
+			if (fd < 0) return false;
+			struct stat st;
+			if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(BookHeader)) { ::close(fd); return false; }
+			void *data = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+			::close(fd);
+			if (data == MAP_FAILED) return false;
+			mapped = data;
+			mappedSize = size_t(st.st_size);
+			size_t size = mappedSize;
+		#endif
+			if (size < sizeof(BookHeader)) return close(), false;
+			const BookHeader *header = (const BookHeader *)data;
+			if (memcmp(header->magic, BOOK_MAGIC, 4) || size < sizeof(BookHeader) + size_t(header->count) * sizeof(BookEntry)) return close(), false;
+			n = header->n;
+			m = header->m;
+			count = header->count;
+			entries = (const BookEntry *)((const char *)data + sizeof(BookHeader));
+			return true;
+		}
+		void close() {
+		#if defined(_WIN32)
+			buffer.clear();
+		#else
+			if (mapped) munmap(mapped, mappedSize);
+			mapped = nullptr;
+		#endif
+			entries = nullptr;
+			count = 0;
+		}
+
+		// stored reply for `tomove` in position `B`, turned back to the board orientation.
+		bool probe(const Board &B, char tomove, pii &move, int *score = nullptr, int *depth = nullptr) const {
+			if (!count || B.n != n || B.m != m) return false;
+			int sym;
+			uint64_t key = bookKey(B, tomove, sym);
+			const BookEntry *end = entries + count;
+			const BookEntry *e = std::lower_bound(entries, end, key, [](const BookEntry &a, uint64_t k) { return a.key < k; });
+			if (e == end || e->key != key) return false;
+			pii found = Board::moveOf(B.fromStored(e->move, sym));
+			if (!B.inBounds(found.i, found.j) || B.at(found.i, found.j) != E) return false;
+			move = found;
+			if (score) *score = e->score;
+			if (depth) *depth = e->depth;
+			return true;
+		}
+
+	private:
+	#if defined(_WIN32)
+		std::vector<char> buffer;
+	#else
+		void *mapped = nullptr;
+		size_t mappedSize = 0;
+	#endif
+	};
+
+	bool writeBook(const std::string &path, int n, int m, std::vector<BookEntry> entries) {
+		std::sort(entries.begin(), entries.end(), [](const BookEntry &a, const BookEntry &b) { return a.key < b.key; });
+		entries.erase(std::unique(entries.begin(), entries.end(), [](const BookEntry &a, const BookEntry &b) { return a.key == b.key; }), entries.end());
+		BookHeader header;
+		memcpy(header.magic, BOOK_MAGIC, 4);
+		header.n = n;
+		header.m = m;
+		header.count = uint32_t(entries.size());
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		if (!file) return false;
+		file.write((const char *)&header, sizeof(header));
+		file.write((const char *)entries.data(), std::streamsize(entries.size() * sizeof(BookEntry)));
+		return bool(file);
+	}
+
+	// offline book: from position of `p` (`tomove` to move) every position up to `plies` moves deep is searched
+	// by `search` (which plays for `p.car`), and the found move is stored. each position is expanded
+	// by the found move and `BOOK_WIDTH - 1` more replies with the best static score, symmetric duplicates skipped.
+	std::vector<BookEntry> buildBook(playerData &p, char tomove, int plies, const std::function<pii(playerData &)> &search) {
+		std::vector<BookEntry> entries;
+		std::unordered_set<uint64_t> seen;
+		std::function<void(char, int)> expand = [&](char side, int ply) {
+			int sym;
+			uint64_t key = bookKey(p.B, side, sym);
+			if (!seen.insert(key).second) return;
+			char other = side == X ? O : X;
+			p.car = side;
+			p.opp = other;
+			p.mylastmove = {-1, -1};
+			pii best = search(p);
+			if (best.i == -1) return;
+			entries.push_back({key, p.score, int16_t(p.B.toStored(Board::cellOf(best), sym)), int16_t(p.searched)});
+			std::cout << "book " << entries.size() << ": ply " << ply << ", " << best.i << " : " << best.j << " (depth: " << p.searched << ", score: " << p.score << ")\n";
+			if (ply + 1 >= plies) return;
+
+			std::vector<pii> moves = p.B.getCandidateMoves();
+			if (p.B.stones == 0) moves.insert(moves.begin(), {p.B.n / 2, p.B.n / 2});
+			std::vector<std::pair<int, int> > ranked;
+			for (size_t k = 0; k < moves.size(); k++) {
+				if (moves[k].i == best.i && moves[k].j == best.j) continue;
+				int value = 0;
+				if (p.B.pattern) {
+					p.B.make(moves[k], side);
+					value = p.B.evaluate(side);
+					p.B.undo(moves[k]);
+				}
+				ranked.push_back({-value, int(k)});
+			}
+			std::stable_sort(ranked.begin(), ranked.end());
+			std::vector<pii> children = {best};
+			for (auto &r: ranked) children.push_back(moves[r.second]);
+
+			std::unordered_set<uint64_t> siblings;
+			for (size_t k = 0, taken = 0; k < children.size() && (int)taken < BOOK_WIDTH; k++) {
+				p.B.make(children[k], side);
+				int s;
+				if (!p.B.isMoveWin(children[k]) && !p.B.full() && siblings.insert(bookKey(p.B, other, s)).second) {
+					taken++;
+					expand(other, ply + 1);
+				}
+				p.B.undo(children[k]);
+			}
+		};
+		expand(tomove, 0);
+		return entries;
+	}
+}
@@ -0,0 +1,238 @@
+#pragma once
+#include "threats.hpp"
+
+#include <mutex>
+
+namespace ttt_agent {
+	// solved value of a position for the side to move. attackers only try frontier cells, so `PROOF_NO_WIN`
+	// (both wins disproved) says no side wins with those moves, not that the position is a draw.
+	enum Proof { PROOF_UNKNOWN = 0, PROOF_WIN, PROOF_LOSS, PROOF_NO_WIN };
+	const uint32_t PN_INF = 100000000;
+
+	// memory bounded table of proof/disproof numbers shared by all solver threads.
+	// bucket holds 4 entries, when full the one with the least work (nodes spent below it) is replaced.
+	// values are kept as (phi, delta): proof and disproof numbers from the view of the side to move.
+	struct ProofTable {
+		struct Entry { uint64_t key = 0; uint32_t phi = 1, delta = 1; uint64_t work = 0; };
+		struct Bucket { Entry slots[4]; };
+		std::unique_ptr<Bucket[]> table;
+		size_t buckets = 0;
+		uint64_t mask = 0;
+		std::mutex locks[1024];
+
+		ProofTable(size_t mb = 256) {
+			size_t limit = std::max<size_t>(mb, 1) * 1024 * 1024 / sizeof(Bucket);
+			buckets = 1;
+			while ((buckets << 1) <= limit) buckets <<= 1;
+			table.reset(new Bucket[buckets]);
+			mask = buckets - 1;
+		}
+
+		// unknown positions read as (1, 1).
+		void get(uint64_t key, uint32_t &phi, uint32_t &delta) {
+			std::lock_guard<std::mutex> guard(locks[key & 1023]);
+			phi = delta = 1;
+			for (auto &e: table[key & mask].slots) {
+				if (e.work && e.key == key) { phi = e.phi; delta = e.delta; return; }
+			}
+		}
+		void put(uint64_t key, uint32_t phi, uint32_t delta, uint64_t work) {
+			std::lock_guard<std::mutex> guard(locks[key & 1023]);
+			Entry *victim = nullptr;
+			for (auto &e: table[key & mask].slots) {
+				if (e.work && e.key == key) { victim = &e; work += e.work; break; }
+				if (!victim || e.work < victim->work) victim = &e;
+			}
+			victim->key = key; victim->phi = phi; victim->delta = delta; victim->work = std::max<uint64_t>(work, 1);
+		}
+	};
+
+	// depth-first proof number search of "attacker wins" on its own board copy. defender goal is to not lose,
+	// so draws count as disproofs. attacker moves are the frontier cells, defender ones are every empty cell,
+	// both narrowed to the forced answers when a four or (for defender) an open three is on board.
+	// attacker nodes first try a short vcf, which proves most wins without expanding them.
+	struct ProofSearch {
+		ProofTable &table;
+		Board B;
+		char attacker;
+		uint64_t salt;
+		// threads break ties between children in different order, so they spread over the tree.
+		int tid;
+		std::atomic<bool> &halt;
+		std::chrono::time_point<std::chrono::high_resolution_clock> deadline;
+		long long nodes = 0;
+		bool out = false;
+		// move lists of `mid()`, its recursion can go as deep as the board is empty.
+		MoveStack stack;
+
+		ProofSearch(ProofTable &table, const Board &B, char attacker, int tid, std::atomic<bool> &halt,
+			std::chrono::time_point<std::chrono::high_resolution_clock> deadline):
+			table(table), B(B), attacker(attacker), salt(attacker == X ? zobrist.side : 0), tid(tid), halt(halt), deadline(deadline) { stack.reset(B); }
+
+		bool timeUp() {
+			if ((++nodes & 255) == 0 && (halt.load(std::memory_order_relaxed) || std::chrono::high_resolution_clock::now() >= deadline)) out = true;
+			return out;
+		}
+
+		// (phi, delta) of position with `tomove` to move when it is over or forced, true if so.
+		bool decided(char tomove, uint32_t &phi, uint32_t &delta) {
+			char other = tomove == X ? O : X;
+			int me = Board::player(tomove), him = Board::player(other);
+			bool win = false, loss = false;
+			ThreatSearch ts(B, tomove, other);
+			pii cell;
+			if (B.threats[him][T_FIVE]) loss = true;
+			else if (ts.winningCells(me, cell)) win = true;
+			else if (ts.winningCells(him, cell) > 1) loss = true;
+			else if (B.full()) win = tomove != attacker, loss = !win;
+			else if (tomove == attacker && (B.threats[me][T_THREE] || B.threats[me][T_OPEN_THREE])) {
+				// a four needs a three to grow from.
+				ts.maxNodes = 1000;
+				for (int depth = 1; depth <= 8 && !win && !ts.out; depth++) win = ts.attack(depth);
+			}
+			if (win) phi = 0, delta = PN_INF;
+			if (loss) phi = PN_INF, delta = 0;
+			return win || loss;
+		}
+
+		int generate(char tomove, pii *moves) {
+			char other = tomove == X ? O : X;
+			ThreatSearch ts(B, other, tomove);
+			pii block;
+			// only blocking the opponent's four does not lose at once.
+			if (ts.winningCells(Board::player(other), block)) {
+				moves[0] = block;
+				return 1;
+			}
+			if (tomove == attacker) return B.candidates(moves);
+			if (B.threats[Board::player(other)][T_OPEN_THREE]) {
+				ts.vct = true;
+				int count = ts.threeAnswers(moves), kept = 0;
+				for (int k = 0; k < count; k++) {
+					B.make(moves[k], tomove);
+					int me = Board::player(tomove);
+					if (!B.threats[Board::player(other)][T_OPEN_THREE] || B.threats[me][T_FOUR] || B.threats[me][T_OPEN_FOUR]) moves[kept++] = moves[k];
+					B.undo(moves[k]);
+				}
+				return kept;
+			}
+			int count = B.candidates(moves);
+			for (int i = 0; i < B.n; i++) {
+				line_t empty = B.valid[0][i] & ~(B.lines[0][0][i] | B.lines[1][0][i]);
+				for (; empty; empty &= empty - 1) {
+					int cell = i * MAX_N + bitLow(empty);
+					if (B.slot[cell] < 0) moves[count++] = Board::moveOf(cell);
+				}
+			}
+			return count;
+		}
+
+		void mid(char tomove, uint32_t thphi, uint32_t thdelta) {
+			char other = tomove == X ? O : X;
+			uint64_t key = B.hash ^ salt;
+			uint32_t phi, delta;
+			table.get(key, phi, delta);
+			if (phi >= thphi || delta >= thdelta || timeUp()) return;
+
+			long long before = nodes;
+			if (phi == 1 && delta == 1 && decided(tomove, phi, delta)) {
+				table.put(key, phi, delta, 1);
+				return;
+			}
+
+			pii *moves = stack.at(B);
+			int count = generate(tomove, moves), me = Board::player(tomove);
+			if (!count) {
+				// nothing but losing moves left.
+				table.put(key, PN_INF, 0, 1);
+				return;
+			}
+			int first = (tid * 7) % count;
+			while (true) {
+				uint32_t second = PN_INF, childPhi = 0;
+				uint64_t sum = 0;
+				int best = -1;
+				phi = PN_INF;
+				for (int s = 0; s < count; s++) {
+					int k = (first + s) % count;
+					uint32_t cphi, cdelta;
+					table.get(key ^ zobrist.keys[me][Board::cellOf(moves[k])], cphi, cdelta);
+					sum += cphi;
+					if (cdelta < phi) second = phi, phi = cdelta, best = k, childPhi = cphi;
+					else if (cdelta < second) second = cdelta;
+				}
+				delta = uint32_t(std::min<uint64_t>(sum, PN_INF));
+				if (phi >= thphi || delta >= thdelta || out) break;
+
+				uint64_t cthphi = uint64_t(thdelta) - delta + childPhi;
+				B.make(moves[best], tomove);
+				// 1+epsilon trick: stay in the child a bit longer than until it stops being the best one.
+				mid(other, uint32_t(std::min<uint64_t>(cthphi, PN_INF)), uint32_t(std::min<uint64_t>(thphi, second + second / 4 + 1)));
+				B.undo(moves[best]);
+			}
+			table.put(key, phi, delta, nodes - before + 1);
+		}
+	};
+
+	struct ProofResult { Proof value = PROOF_UNKNOWN; pii move = {-1, -1}; long long nodes = 0; };
+
+	// proves position of `B` with `tomove` to move won or lost (or disproves both), using `threadNum` threads
+	// on a `mb` megabytes table. first tries to prove a win of `tomove`, then one of the opponent.
+	// `move` is the winning move (or any one in a loss).
+	ProofResult solvePosition(const Board &B, char tomove, int threadNum = 1, int timeLimitMs = 300000, size_t mb = 256) {
+		ProofResult result;
+		if (!B.pattern) return result;
+		auto start = std::chrono::high_resolution_clock::now(), end = start + std::chrono::milliseconds(timeLimitMs);
+		std::unique_ptr<ProofTable> table(new ProofTable(mb));
+		char other = tomove == X ? O : X;
+		bool disproved[2] = {false, false};
+		threadNum = std::max(threadNum, 1);
+
+		for (int run = 0; run < 2 && result.value == PROOF_UNKNOWN; run++) {
+			char attacker = run ? other : tomove;
+			// first run may take half of the time, the second one whatever is left.
+			auto deadline = run ? end : start + std::chrono::milliseconds(timeLimitMs / 2);
+			std::atomic<bool> halt(false);
+			std::atomic<long long> nodes(0);
+			std::vector<std::thread> threads;
+			auto work = [&](int tid) {
+				ProofSearch s(*table, B, attacker, tid, halt, deadline);
+				s.mid(tomove, PN_INF, PN_INF);
+				halt = true;
+				nodes += s.nodes;
+			};
+			for (int k = 1; k < threadNum; k++) threads.emplace_back(work, k);
+			work(0);
+			for (auto &t: threads) t.join();
+			result.nodes += nodes;
+
+			uint32_t phi, delta;
+			uint64_t key = B.hash ^ (attacker == X ? zobrist.side : 0);
+			table->get(key, phi, delta);
+			// root values are from the view of `tomove`.
+			if (!run && phi == 0) result.value = PROOF_WIN;
+			if (run && delta == 0) result.value = PROOF_LOSS;
+			disproved[run] = run ? phi == 0 : phi >= PN_INF;
+
+			// winning move leads to a disproved child, in a loss every move is as bad.
+			if (result.value == PROOF_UNKNOWN) continue;
+			ProofSearch s(*table, B, attacker, 0, halt, deadline);
+			pii moves[MAX_CELLS];
+			int count = s.generate(tomove, moves);
+			for (int k = 0; k < count && result.move.i == -1; k++) {
+				uint32_t cphi, cdelta;
+				table->get(key ^ zobrist.keys[Board::player(tomove)][Board::cellOf(moves[k])], cphi, cdelta);
+				if (result.value == PROOF_LOSS || cdelta == 0) result.move = moves[k];
+			}
+			if (result.move.i == -1) {
+				// proved at the root itself (vcf or a four to finish).
+				playerData p{B};
+				p.car = tomove;
+				p.opp = other;
+				threatSpaceWin(p, result.move, timeLimitMs);
+			}
+		}
+		if (disproved[0] && disproved[1]) result.value = PROOF_NO_WIN;
+		return result;
+	}
+}
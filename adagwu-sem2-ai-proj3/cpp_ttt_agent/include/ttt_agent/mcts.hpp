@@ -0,0 +1,266 @@
+#pragma once
+#include "threats.hpp"
+
+#include <cmath>
+
+namespace ttt_agent {
+	// exploration constant of PUCT selection.
+	const double PUCT_C = 1.5;
+	// visits (counted as losses) a thread adds to every node on its path until its playout is back,
+	// so other threads prefer different paths.
+	const int VIRTUAL_LOSS = 3;
+
+	// monte carlo search tree in one preallocated node array, shared by all threads (tree parallelism).
+	// statistics of a node are from the view of the player who made its move. children of a node are one
+	// contiguous block, made by the first thread which gets there, others just play out meanwhile.
+	struct MctsTree {
+		struct Node {
+			std::atomic<int> visits{0}, virtualLoss{0};
+			// playout results in half points: win 2, draw 1, loss 0.
+			std::atomic<long long> score{0};
+			// 0 - leaf, 1 - being expanded, 2 - children ready.
+			std::atomic<int> state{0};
+			int first = 0, count = 0, cell = -1;
+			float prior = 1;
+
+			void init(int c, float p) {
+				visits.store(0, std::memory_order_relaxed);
+				virtualLoss.store(0, std::memory_order_relaxed);
+				score.store(0, std::memory_order_relaxed);
+				state.store(0, std::memory_order_relaxed);
+				first = count = 0;
+				cell = c;
+				prior = p;
+			}
+		};
+		std::unique_ptr<Node[]> nodes;
+		int capacity = 0;
+		std::atomic<int> used{0};
+		int root = -1;
+		// position of the root, to find it again two plies later.
+		uint64_t rootHash = 0;
+
+		MctsTree(size_t mb = 64) {
+			capacity = int(std::min<size_t>(std::max<size_t>(mb, 1) * 1024 * 1024 / sizeof(Node), INT_MAX / 2));
+			nodes.reset(new Node[capacity]);
+		}
+
+		// first of `count` fresh nodes, -1 once the array is full.
+		int allocate(int count) {
+			int at = used.fetch_add(count, std::memory_order_relaxed);
+			return at + count <= capacity ? at : -1;
+		}
+		void clear(const Board &B) {
+			used = 0;
+			root = allocate(1);
+			nodes[root].init(-1, 1);
+			rootHash = B.hash;
+		}
+		// keeps the subtree of position `B` when it is the root or two plies below it (our move, their answer),
+		// else (or when over half of the array is used up) starts a new tree.
+		// nodes outside of the kept subtree are not reclaimed until then.
+		void reuse(const Board &B, char car) {
+			if (root < 0 || used.load() > capacity / 2) return clear(B);
+			if (B.hash == rootHash) return;
+			const int me = Board::player(car);
+			Node &r = nodes[root];
+			for (int a = 0; r.state.load() == 2 && a < r.count; a++) {
+				Node &child = nodes[r.first + a];
+				uint64_t hash = rootHash ^ zobrist.keys[me][child.cell];
+				for (int b = 0; child.state.load() == 2 && b < child.count; b++) {
+					int next = child.first + b;
+					if ((hash ^ zobrist.keys[me ^ 1][nodes[next].cell]) != B.hash) continue;
+					root = next;
+					rootHash = B.hash;
+					return;
+				}
+			}
+			clear(B);
+		}
+
+		// children of `node` at position `B` with `tomove` to move: only blocks when the opponent has a four,
+		// else every frontier cell, priors from the threat classes the move makes and breaks.
+		void expand(int node, const Board &B, char tomove) {
+			Node &n = nodes[node];
+			int expected = 0;
+			if (!n.state.compare_exchange_strong(expected, 1)) return;
+			const int me = Board::player(tomove);
+			const bool forced = B.pattern && (B.threats[me ^ 1][T_FOUR] || B.threats[me ^ 1][T_OPEN_FOUR]);
+			pii moves[MAX_CELLS];
+			float weight[MAX_CELLS], total = 0;
+			int count = B.candidates(moves), kept = 0;
+			for (int k = 0; k < count; k++) {
+				if (forced && B.threatAt(moves[k], me ^ 1) != T_FIVE) continue;
+				float w = 1;
+				if (B.pattern) w += Board::threatWeight[B.threatAt(moves[k], me)] + Board::threatWeight[B.threatAt(moves[k], me ^ 1)] * 0.5f;
+				moves[kept] = moves[k];
+				weight[kept++] = w;
+				total += w;
+			}
+			int first = kept ? allocate(kept) : -1;
+			if (first < 0) {
+				n.state.store(0);
+				return;
+			}
+			for (int k = 0; k < kept; k++) nodes[first + k].init(Board::cellOf(moves[k]), weight[k] / total);
+			n.first = first;
+			n.count = kept;
+			n.state.store(2, std::memory_order_release);
+		}
+
+		// child of `node` with best PUCT value, virtual loss counts as lost visits.
+		int select(int node) const {
+			const Node &n = nodes[node];
+			double sqrtParent = std::sqrt(double(n.visits.load(std::memory_order_relaxed) + n.virtualLoss.load(std::memory_order_relaxed) + 1));
+			double bestValue = -1;
+			int best = n.first;
+			for (int k = n.first; k < n.first + n.count; k++) {
+				const Node &c = nodes[k];
+				int visits = c.visits.load(std::memory_order_relaxed) + c.virtualLoss.load(std::memory_order_relaxed);
+				double q = visits ? c.score.load(std::memory_order_relaxed) / (2.0 * visits) : 0.5;
+				double value = q + PUCT_C * c.prior * sqrtParent / (1 + visits);
+				if (value > bestValue) bestValue = value, best = k;
+			}
+			return best;
+		}
+
+		// random game from `B` with `tomove` to move, over frontier cells. a four is always finished and
+		// an opponent one blocked. returns winning player (0/1) or -1 for a draw, the board is left as it was.
+		static int playout(Board &B, char tomove, uint64_t &rng) {
+			pii made[MAX_CELLS];
+			int count = 0, winner = -1;
+			char other = tomove == X ? O : X;
+			while (true) {
+				const int me = Board::player(tomove);
+				pii move = {-1, -1};
+				if (B.pattern) {
+					ThreatSearch ts(B, tomove, other);
+					if (ts.winningCells(me, move)) { winner = me; break; }
+					int blocks = ts.winningCells(me ^ 1, move);
+					if (blocks > 1) { winner = me ^ 1; break; }
+				}
+				if (move.i == -1) {
+					if (!B.frontierSize) break;
+					move = Board::moveOf(B.frontier[splitmix64(rng) % B.frontierSize]);
+				}
+				B.make(move, tomove);
+				made[count++] = move;
+				if (B.isMoveWin(move)) { winner = me; break; }
+				if (B.full()) break;
+				std::swap(tomove, other);
+			}
+			while (count) B.undo(made[--count]);
+			return winner;
+		}
+
+		// one selection, expansion, playout and backup on the thread's copy `B` of the root position.
+		// returns depth of the reached leaf.
+		int iterate(Board &B, char car, uint64_t &rng) {
+			int path[MAX_CELLS + 1], depth = 0, winner = -1;
+			pii made[MAX_CELLS];
+			char tomove = car, other = car == X ? O : X;
+			bool over = false;
+			path[0] = root;
+			nodes[root].virtualLoss.fetch_add(VIRTUAL_LOSS, std::memory_order_relaxed);
+			while (true) {
+				Node &n = nodes[path[depth]];
+				if (n.state.load(std::memory_order_acquire) != 2) {
+					if (n.visits.load(std::memory_order_relaxed) || !depth) expand(path[depth], B, tomove);
+					if (n.state.load(std::memory_order_acquire) != 2) break;
+				}
+				if (!n.count) break;
+				int child = select(path[depth]);
+				nodes[child].virtualLoss.fetch_add(VIRTUAL_LOSS, std::memory_order_relaxed);
+				pii move = Board::moveOf(nodes[child].cell);
+				B.make(move, tomove);
+				made[depth++] = move;
+				path[depth] = child;
+				if (B.isMoveWin(move)) {
+					winner = Board::player(tomove);
+					over = true;
+					break;
+				}
+				std::swap(tomove, other);
+				if (B.full()) { over = true; break; }
+			}
+			if (!over) winner = playout(B, tomove, rng);
+			for (int k = depth - 1; k >= 0; k--) B.undo(made[k]);
+
+			// player of the move at path[k] alternates, root children are moves of `car`.
+			int mover = Board::player(car) ^ 1;
+			for (int k = 0; k <= depth; k++, mover ^= 1) {
+				Node &n = nodes[path[k]];
+				n.score.fetch_add(winner < 0 ? 1 : (winner == mover ? 2 : 0), std::memory_order_relaxed);
+				n.visits.fetch_add(1, std::memory_order_relaxed);
+				n.virtualLoss.fetch_sub(VIRTUAL_LOSS, std::memory_order_relaxed);
+			}
+			return depth;
+		}
+
+		// most visited child of `node`, -1 if it has none.
+		int bestChild(int node) const {
+			const Node &n = nodes[node];
+			if (n.state.load() != 2 || !n.count) return -1;
+			int best = n.first;
+			for (int k = n.first; k < n.first + n.count; k++) {
+				if (nodes[k].visits.load() > nodes[best].visits.load()) best = k;
+			}
+			return best;
+		}
+	};
+
+	// monte carlo tree search for `p.car` with `threadNum` threads sharing one tree (kept in `p.tree` between moves).
+	// `p.nodes` gets the number of playouts, `p.searched` the deepest reached leaf.
+	pii mctsBest(playerData &p, int threadNum = 1, int timeLimitMs = 30000) {
+		auto start = std::chrono::high_resolution_clock::now();
+		p.searched = 0;
+		p.nodes = 0;
+		p.pv.clear();
+		p.score = 0;
+		p.stats.clear();
+		if (quickMove(p, p.mylastmove)) return p.mylastmove;
+
+		if (!p.tree) p.tree = std::make_shared<MctsTree>(p.tt->megabytes());
+		MctsTree &tree = *p.tree;
+		tree.reuse(p.B, p.car);
+		std::atomic<bool> halt(false);
+		std::atomic<long long> playouts(0);
+		std::atomic<int> deepest(0);
+		threadNum = std::max(threadNum, 1);
+		p.stats.threadNodes.assign(threadNum, 0);
+		auto work = [&](int tid) {
+			Board B = p.B;
+			uint64_t rng = p.B.hash + tid * 0x9E3779B97F4A7C15ull;
+			long long done = 0;
+			int depth = 0;
+			while (!halt.load(std::memory_order_relaxed)) {
+				depth = std::max(depth, tree.iterate(B, p.car, rng));
+				done++;
+				// with a budget (playouts of each thread) the clock is not read.
+				if (p.maxNodes) {
+					if (done >= p.maxNodes || (p.halt && p.halt->load(std::memory_order_relaxed))) halt = true;
+				}
+				else if ((done & 63) == 0) {
+					auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start).count();
+					if (elapsed >= timeLimitMs || (p.halt && p.halt->load(std::memory_order_relaxed))) halt = true;
+				}
+			}
+			playouts += done;
+			p.stats.threadNodes[tid] = done;
+			int seen = deepest.load();
+			while (depth > seen && !deepest.compare_exchange_weak(seen, depth));
+		};
+		std::vector<std::thread> threads;
+		for (int k = 1; k < threadNum; k++) threads.emplace_back(work, k);
+		work(0);
+		for (auto &t: threads) t.join();
+
+		for (int node = tree.bestChild(tree.root); node >= 0; node = tree.bestChild(node)) p.pv.push_back(Board::moveOf(tree.nodes[node].cell));
+		std::vector<pii> moves = p.B.getCandidateMoves();
+		pii best = p.pv.size() ? p.pv[0] : (moves.size() ? moves[0] : pii{-1, -1});
+		p.nodes = playouts;
+		p.searched = deepest;
+		p.mylastmove = best;
+		return best;
+	}
+}
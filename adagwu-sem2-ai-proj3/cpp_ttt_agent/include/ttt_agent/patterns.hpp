@@ -0,0 +1,96 @@
+#pragma once
+#include <vector>
+#include <mutex>
+#include <cstdint>
+
+namespace ttt_agent {
+	// threat class of one line through one stone, stronger classes have bigger values.
+	// four - one move from `m` in a row (one winning cell), open four - two or more winning cells,
+	// three/open three - one move from four/open four, two/open two - one move from three/open three.
+	enum Threat : uint8_t { T_NONE = 0, T_TWO, T_OPEN_TWO, T_THREE, T_OPEN_THREE, T_FOUR, T_OPEN_FOUR, T_FIVE, THREAT_COUNT };
+
+	// biggest win length with generated tables (3^(2m-1) entries), longer lines use plain scans.
+	const int MAX_PATTERN_M = 7;
+
+	// lookup tables for windows of `2m-1` cells centered on a stone of the owner.
+	// every cell is a base 3 digit: 0 empty, 1 own stone, 2 blocked (opponent stone or outside of board),
+	// so window of two bit masks (own, blocked) is turned into index by `ternary` table.
+	struct PatternTable {
+		int m = 0, width = 0;
+		std::vector<uint32_t> ternary;
+		std::vector<uint8_t> threat;
+		// for fours: offset (from center) of a winning cell, for threes/twos: of the cell which upgrades it.
+		std::vector<int8_t> gain;
+
+		int index(uint32_t own, uint32_t blocked) const { return ternary[own] + 2 * ternary[blocked]; }
+
+		void build(int m) {
+			this->m = m;
+			width = 2 * m - 1;
+			std::vector<int> pow3(width + 1, 1);
+			for (int k = 1; k <= width; k++) pow3[k] = pow3[k - 1] * 3;
+
+			ternary.assign(size_t(1) << width, 0);
+			for (uint32_t mask = 1; mask < ternary.size(); mask++) {
+				int low = 0;
+				while (!(mask >> low & 1)) low++;
+				ternary[mask] = ternary[mask & (mask - 1)] + pow3[low];
+			}
+
+			threat.assign(pow3[width], UNKNOWN);
+			gain.assign(pow3[width], 0);
+			for (int idx = 0; idx < pow3[width]; idx++) {
+				if (idx / pow3[m - 1] % 3 == 1) classify(idx, pow3);
+			}
+		}
+
+	private:
+		static constexpr uint8_t UNKNOWN = 0xFF;
+
+		// length of own run through center, `extra` cell is counted as own.
+		int runThrough(const int *cells, int extra) const {
+			int center = m - 1, run = 1;
+			for (int k = center + 1; k < width && (cells[k] == 1 || k == extra); k++) run++;
+			for (int k = center - 1; k >= 0 && (cells[k] == 1 || k == extra); k--) run++;
+			return run;
+		}
+
+		uint8_t classify(int idx, const std::vector<int> &pow3) {
+			if (threat[idx] != UNKNOWN) return threat[idx];
+			int cells[2 * MAX_PATTERN_M - 1], center = m - 1;
+			for (int k = 0; k < width; k++) cells[k] = idx / pow3[k] % 3;
+
+			uint8_t result = T_NONE;
+			int wins = 0, point = 0;
+			if (runThrough(cells, -1) >= m) result = T_FIVE;
+			else {
+				for (int k = 0; k < width; k++) {
+					if (cells[k] || runThrough(cells, k) < m) continue;
+					if (!wins++) point = k - center;
+				}
+				if (wins) result = wins >= 2 ? T_OPEN_FOUR : T_FOUR;
+			}
+
+			if (result == T_NONE) {
+				static const uint8_t weaker[THREAT_COUNT] = { T_NONE, T_NONE, T_NONE, T_TWO, T_OPEN_TWO, T_THREE, T_OPEN_THREE, T_NONE };
+				for (int k = 0; k < width; k++) {
+					if (cells[k]) continue;
+					uint8_t upgraded = weaker[classify(idx + pow3[k], pow3)];
+					if (upgraded > result) result = upgraded, point = k - center;
+				}
+			}
+
+			gain[idx] = int8_t(point);
+			return threat[idx] = result;
+		}
+	};
+
+	// table for win length `m` (nullptr if `m` is too long), built once on first request.
+	inline const PatternTable *patternTable(int m) {
+		static PatternTable tables[MAX_PATTERN_M + 1];
+		static std::once_flag built[MAX_PATTERN_M + 1];
+		if (m < 1 || m > MAX_PATTERN_M) return nullptr;
+		std::call_once(built[m], [m] { tables[m].build(m); });
+		return &tables[m];
+	}
+}
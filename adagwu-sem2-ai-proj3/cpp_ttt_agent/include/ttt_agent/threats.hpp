@@ -0,0 +1,163 @@
+#pragma once
+#include "ttt_agent2.hpp"
+
+namespace ttt_agent {
+	// threat space search: attacker only plays moves that make a four (vcf) or also an open three (vct),
+	// defender only answers them (blocks or counter fours), so forced wins are found far deeper than
+	// the full width search can go. needs pattern tables, `depth` counts attacker threats.
+	struct ThreatSearch {
+		Board &B;
+		int att, def;
+		char attacker, defender;
+		bool vct = false;
+		// set once time or node budget is over, the result is then "not found".
+		bool out = false;
+		long long nodes = 0, maxNodes = LLONG_MAX;
+		std::chrono::time_point<std::chrono::high_resolution_clock> deadline = std::chrono::time_point<std::chrono::high_resolution_clock>::max();
+
+		ThreatSearch(Board &B, char attacker, char defender): B(B), att(Board::player(attacker)), def(Board::player(defender)),
+			attacker(attacker), defender(defender) {}
+
+		bool timeUp() {
+			if (!out && ++nodes >= maxNodes) out = true;
+			if (!out && (nodes & 1023) == 0 && std::chrono::high_resolution_clock::now() >= deadline) out = true;
+			return out;
+		}
+		// distinct cells where `pl` completes a line (counting stops at 2), one of them goes to `cell`.
+		int winningCells(int pl, pii &cell) const {
+			if (!B.threats[pl][T_FOUR] && !B.threats[pl][T_OPEN_FOUR]) return 0;
+			int count = 0;
+			for (int i = 0; i < B.n; i++) {
+				for (line_t row = B.lines[pl][0][i]; row; row &= row - 1) {
+					pii stone = {i, bitLow(row)};
+					for (int d = 0; d < 4; d++) {
+						int t = B.pat[d][Board::cellOf(stone)], gain;
+						if (t != T_FOUR && t != T_OPEN_FOUR) continue;
+						B.lineThreat(d, B.lineOf(d, stone.i, stone.j), B.bitOf(d, stone.i, stone.j), pl, &gain);
+						pii c = Board::stepFrom(stone, d, gain);
+						if (!count) cell = c, count = 1;
+						if (t == T_OPEN_FOUR) return 2;
+						else if (c.i != cell.i || c.j != cell.j) return 2;
+					}
+				}
+			}
+			return count;
+		}
+		// empty cells (of the whole board) where `pl` gets at least class `least`, fours first.
+		int threatMoves(int pl, int least, pii *out) const {
+			int count = 0, fours = 0;
+			for (int i = 0; i < B.n; i++) {
+				line_t empty = B.valid[0][i] & ~(B.lines[0][0][i] | B.lines[1][0][i]);
+				for (; empty; empty &= empty - 1) {
+					pii move = {i, bitLow(empty)};
+					int t = B.threatAt(move, pl);
+					if (t < least) continue;
+					out[count++] = move;
+					if (t >= T_FOUR) std::swap(out[fours++], out[count - 1]);
+				}
+			}
+			return count;
+		}
+
+		// possible defender answers to attacker open threes: every counter four first,
+		// then empty cells on lines of the threes (within `m - 1` of their stones).
+		int threeAnswers(pii *moves) const {
+			bool seen[MAX_CELLS] = {false};
+			int count = threatMoves(def, T_FOUR, moves);
+			for (int k = 0; k < count; k++) seen[Board::cellOf(moves[k])] = true;
+			for (int i = 0; i < B.n; i++) {
+				for (line_t row = B.lines[att][0][i]; row; row &= row - 1) {
+					pii stone = {i, bitLow(row)};
+					for (int d = 0; d < 4; d++) {
+						if (B.pat[d][Board::cellOf(stone)] != T_OPEN_THREE) continue;
+						for (int s = -(B.m - 1); s < B.m; s++) {
+							pii c = Board::stepFrom(stone, d, s);
+							if (!B.inBounds(c.i, c.j) || B.at(c.i, c.j) != E || seen[Board::cellOf(c)]) continue;
+							seen[Board::cellOf(c)] = true;
+							moves[count++] = c;
+						}
+					}
+				}
+			}
+			return count;
+		}
+
+		// attacker to move, `win` (root only) receives the winning threat.
+		bool attack(int depth, pii *win = nullptr) {
+			if (timeUp()) return false;
+			pii block;
+			if (winningCells(att, block)) {
+				if (win) *win = block;
+				return true;
+			}
+			int forced = winningCells(def, block);
+			if (forced > 1) return false;
+			if (forced == 1) {
+				// defender's four has to be blocked, which is only good if the block is a threat too.
+				if (!depth) return false;
+				B.make(block, attacker);
+				bool won = B.isMoveWin(block) || defend(depth - 1);
+				B.undo(block);
+				if (won && win) *win = block;
+				return won;
+			}
+			if (!depth) return false;
+
+			pii moves[MAX_CELLS];
+			int count = threatMoves(att, vct ? T_OPEN_THREE : T_FOUR, moves);
+			for (int k = 0; k < count && !out; k++) {
+				B.make(moves[k], attacker);
+				bool won = B.isMoveWin(moves[k]) || defend(depth - 1);
+				B.undo(moves[k]);
+				if (won) {
+					if (win) *win = moves[k];
+					return true;
+				}
+			}
+			return false;
+		}
+
+		// defender to move after an attacker threat. true if every answer still loses.
+		bool defend(int depth) {
+			if (timeUp()) return false;
+			pii block;
+			if (winningCells(def, block)) return false;
+			int fours = winningCells(att, block);
+			if (fours > 1) return true;
+			if (fours == 1) {
+				B.make(block, defender);
+				bool won = attack(depth);
+				B.undo(block);
+				return won;
+			}
+			if (!vct || !B.threats[att][T_OPEN_THREE]) return false;
+
+			// answers that leave no attacker open three, or make a counter four.
+			pii moves[MAX_CELLS];
+			int count = threeAnswers(moves);
+			for (int k = 0; k < count; k++) {
+				B.make(moves[k], defender);
+				bool won = true;
+				if (!B.threats[att][T_OPEN_THREE] || B.threats[def][T_FOUR] || B.threats[def][T_OPEN_FOUR]) won = attack(depth);
+				B.undo(moves[k]);
+				if (!won || out) return false;
+			}
+			return true;
+		}
+	};
+
+	// looks for a forced win of `p.car` by continuous fours, then also open threes, deepening one threat at a time.
+	// first move of the win goes to `move`. `timeLimitMs` is the slice of move time it may take, `maxNodes` the node budget.
+	bool threatSpaceWin(playerData &p, pii &move, int timeLimitMs, int vcfDepth = 24, int vctDepth = 10, long long maxNodes = LLONG_MAX) {
+		if (!p.B.pattern || p.B.lastmove.i == -1) return false;
+		ThreatSearch ts(p.B, p.car, p.opp);
+		ts.deadline = std::chrono::high_resolution_clock::now() + std::chrono::milliseconds(timeLimitMs);
+		ts.maxNodes = maxNodes;
+		bool found = false;
+		for (int vct = 0; vct < 2 && !found; vct++) {
+			ts.vct = vct;
+			for (int depth = 1; depth <= (vct ? vctDepth : vcfDepth) && !ts.out && !found; depth++) found = ts.attack(depth, &move);
+		}
+		return found;
+	}
+}
@@ -0,0 +1,188 @@
+#pragma once
+#include "mcts.hpp"
+
+#include <cmath>
+#include <mutex>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <functional>
+#include <unordered_set>
+
+namespace ttt_agent {
+	// stones placed before the engines take over, alternately starting with O.
+	using Opening = std::vector<pii>;
+
+	// one opening per line as "i,j i,j ..", empty lines and ones starting with '#' are skipped.
+	// a line ends at the first move off the board or on a taken cell.
+	std::vector<Opening> readOpenings(const std::string &path, int n) {
+		std::vector<Opening> openings;
+		std::ifstream file(path);
+		std::string line;
+		while (std::getline(file, line)) {
+			if (line.empty() || line[0] == '#') continue;
+			std::istringstream in(line);
+			std::unordered_set<int> taken;
+			Opening opening;
+			pii move;
+			char comma;
+			while (in >> move.i >> comma >> move.j) {
+				if (move.i < 0 || move.j < 0 || move.i >= n || move.j >= n || !taken.insert(Board::cellOf(move)).second) break;
+				opening.push_back(move);
+			}
+			if (opening.size()) openings.push_back(opening);
+		}
+		return openings;
+	}
+	bool writeOpenings(const std::string &path, const std::vector<Opening> &openings) {
+		std::ofstream file(path, std::ios::trunc);
+		if (!file) return false;
+		for (auto &opening: openings) {
+			for (size_t k = 0; k < opening.size(); k++) file << (k ? " " : "") << opening[k].i << "," << opening[k].j;
+			file << "\n";
+		}
+		return bool(file);
+	}
+
+	// `count` openings of `stones` random moves within distance 2 of the center, same `seed` gives same ones.
+	// no two are symmetric to each other, and none leaves a three or more on board, so neither side starts
+	// with a forcing attack (playing each of them with both colors evens out the rest).
+	std::vector<Opening> generateOpenings(int n, int m, int count, int stones, uint64_t seed) {
+		std::vector<Opening> openings;
+		std::unordered_set<uint64_t> seen;
+		const int c = n / 2, r = std::min(2, c), width = std::min(2 * r + 1, n);
+		stones = std::min(stones, width * width);
+		for (int attempt = 0; (int)openings.size() < count && attempt < count * 100; attempt++) {
+			Board B(n, m);
+			Opening opening;
+			char side = O;
+			bool calm = true;
+			while ((int)opening.size() < stones && calm) {
+				pii move = {c - r + int(splitmix64(seed) % width), c - r + int(splitmix64(seed) % width)};
+				if (!B.inBounds(move.i, move.j) || B.at(move.i, move.j) != E) continue;
+				B.make(move, side);
+				opening.push_back(move);
+				calm = !B.isMoveWin(move);
+				for (int pl = 0; pl < 2 && calm && B.pattern; pl++) {
+					for (int t = T_THREE; t < THREAT_COUNT; t++) calm = calm && !B.threats[pl][t];
+				}
+				side = side == X ? O : X;
+			}
+			if (calm && seen.insert(B.symHash[B.canonical()]).second) openings.push_back(opening);
+		}
+		return openings;
+	}
+
+	// totals of one engine over the moves it searched (book and forced moves without nodes are not counted).
+	struct EngineTally {
+		long long nodes = 0, ms = 0, depth = 0, moves = 0;
+		void add(const EngineTally &o) { nodes += o.nodes; ms += o.ms; depth += o.depth; moves += o.moves; }
+	};
+
+	// results from the view of engine 0.
+	struct TournamentResult {
+		int wins = 0, draws = 0, losses = 0;
+		EngineTally engines[2];
+
+		int games() const { return wins + draws + losses; }
+		double score() const { return games() ? (wins + draws * 0.5) / games() : 0.5; }
+		// elo difference of engine 0 over engine 1 and the half width of its 95% confidence interval,
+		// from the normal approximation of the mean game score.
+		void elo(double &diff, double &error) const {
+			const int count = games();
+			auto toElo = [count](double s) {
+				double limit = count ? 0.5 / count : 0.5;
+				s = std::min(std::max(s, limit), 1 - limit);
+				return -400 * std::log10(1 / s - 1);
+			};
+			const double s = score();
+			double variance = 0;
+			if (count) variance = (wins * (1 - s) * (1 - s) + draws * (0.5 - s) * (0.5 - s) + losses * s * s) / count;
+			double margin = 1.96 * std::sqrt(variance / std::max(count, 1));
+			diff = toElo(s);
+			error = (toElo(s + margin) - toElo(s - margin)) / 2;
+		}
+	};
+
+	using EngineSearch = std::function<pii(playerData &, int)>;
+
+	// one game from `opening` between `players[0]` and `players[1]` (boards are reset), players[0] is O (moves first)
+	// when `firstStarts`. `search(player, engine)` makes every move. returns the winning engine, -1 for a draw
+	// (also for an opening which is already over), a side which returns an illegal move loses.
+	int playGame(playerData *players[2], const Opening &opening, bool firstStarts, const EngineSearch &search, EngineTally tally[2]) {
+		const int n = players[0]->B.n, m = players[0]->B.m;
+		int starter = firstStarts ? 0 : 1;
+		for (int e = 0; e < 2; e++) {
+			playerData &p = *players[e];
+			p.B = Board(n, m);
+			p.car = e == starter ? O : X;
+			p.opp = e == starter ? X : O;
+			p.mylastmove = {-1, -1};
+		}
+		char current = O;
+		for (auto &move: opening) {
+			for (int e = 0; e < 2; e++) players[e]->B.make(move, current);
+			if (players[0]->B.isMoveWin(move)) return -1;
+			current = current == X ? O : X;
+		}
+		int winner = -1;
+		while (!players[0]->B.full()) {
+			const int e = current == O ? starter : starter ^ 1;
+			playerData &p = *players[e];
+			auto start = std::chrono::high_resolution_clock::now();
+			pii move = search(p, e);
+			long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start).count();
+			if (p.nodes) tally[e].add({p.nodes, ms, p.searched, 1});
+			if (!p.B.inBounds(move.i, move.j) || p.B.at(move.i, move.j) != E) { winner = e ^ 1; break; }
+			for (int k = 0; k < 2; k++) players[k]->B.make(move, current);
+			if (p.B.isMoveWin(move)) { winner = e; break; }
+			current = current == X ? O : X;
+		}
+		return winner;
+	}
+
+	// `games` games of engine 0 (`first`) against engine 1 (`second`), `parallel` at a time. game k starts from
+	// opening k/2 (cycling) and the second game of every pair swaps colors. every game runner has its own
+	// copies of both players with own transposition tables, cleared before each game.
+	TournamentResult runTournament(const playerData &first, const playerData &second, const std::vector<Opening> &openings,
+		int games, int parallel, const EngineSearch &search) {
+		TournamentResult result;
+		std::mutex lock;
+		std::atomic<int> next(0);
+		const std::vector<Opening> starts = openings.size() ? openings : std::vector<Opening>{Opening()};
+		auto work = [&]() {
+			playerData a = first, b = second;
+			for (playerData *p: {&a, &b}) {
+				p->tt = std::make_shared<TransTable>(p->tt->megabytes());
+				p->tree.reset();
+				p->helpers.reset();
+				p->halt = nullptr;
+			}
+			playerData *players[2] = {&a, &b};
+			for (int k = next++; k < games; k = next++) {
+				for (playerData *p: players) {
+					p->tt->clear();
+					p->order.clear();
+					if (p->tree) p->tree->clear(p->B);
+				}
+				EngineTally tally[2];
+				const size_t opening = (k / 2) % starts.size();
+				int winner = playGame(players, starts[opening], k % 2 == 0, search, tally);
+
+				std::lock_guard<std::mutex> guard(lock);
+				if (winner == 0) result.wins++;
+				else if (winner == 1) result.losses++;
+				else result.draws++;
+				for (int e = 0; e < 2; e++) result.engines[e].add(tally[e]);
+				std::cout << "game " << k + 1 << "/" << games << ", opening " << opening + 1 << ", A plays " << (k % 2 == 0 ? O : X) << ": "
+					<< (winner == 0 ? "A wins" : (winner == 1 ? "B wins" : "draw")) << " (" << a.B.stones << " stones), total +"
+					<< result.wins << " =" << result.draws << " -" << result.losses << "\n";
+			}
+		};
+		std::vector<std::thread> threads;
+		for (int k = 1; k < std::min(std::max(parallel, 1), std::max(games, 1)); k++) threads.emplace_back(work);
+		work();
+		for (auto &t: threads) t.join();
+		return result;
+	}
+}
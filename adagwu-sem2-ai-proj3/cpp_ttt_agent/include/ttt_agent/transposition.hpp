@@ -0,0 +1,106 @@
+#pragma once
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include <algorithm>
+
+namespace ttt_agent {
+	// what stored value says about the real score of position.
+	enum Bound : uint8_t { BOUND_NONE = 0, BOUND_EXACT, BOUND_LOWER, BOUND_UPPER };
+
+	// fixed memory table keyed by 64 bit zobrist hash, it is meant to live through the whole game.
+	// every bucket has two slots: depth-preferred one keeps the deepest result of the current search,
+	// and always-replace one takes whatever did not fit there. entries of older searches
+	// (generation is bumped by `newSearch()`) lose their depth preference and get overwritten first.
+	//
+	// all search threads share one table without locks: a slot is two relaxed atomic words,
+	// packed data and `key ^ data`. torn slot (words from two different writes) fails the key check
+	// on probe, so reader sees either a whole entry or a miss.
+	struct TransTable {
+		// `depth` - remaining depth the value was searched to, `move` - best/refutation cell (-1 if none).
+		// `genbound` - generation in high 6 bits and `Bound` in low 2 bits.
+		struct Entry {
+			uint64_t key = 0; int32_t value = 0; int16_t move = -1; int8_t depth = 0; uint8_t genbound = BOUND_NONE;
+			Bound bound() const { return Bound(genbound & 3); }
+			uint8_t gen() const { return genbound >> 2; }
+
+			uint64_t pack() const {
+				return uint64_t(uint32_t(value)) | uint64_t(uint16_t(move)) << 32 | uint64_t(uint8_t(depth)) << 48 | uint64_t(genbound) << 56;
+			}
+			static Entry unpack(uint64_t key, uint64_t data) {
+				Entry e;
+				e.key = key; e.value = int32_t(uint32_t(data)); e.move = int16_t(uint16_t(data >> 32));
+				e.depth = int8_t(uint8_t(data >> 48)); e.genbound = uint8_t(data >> 56);
+				return e;
+			}
+		};
+		struct Slot {
+			std::atomic<uint64_t> check{0}, data{0};
+			Entry load() const {
+				uint64_t d = data.load(std::memory_order_relaxed);
+				return Entry::unpack(check.load(std::memory_order_relaxed) ^ d, d);
+			}
+			void save(const Entry &e) {
+				uint64_t d = e.pack();
+				check.store(e.key ^ d, std::memory_order_relaxed);
+				data.store(d, std::memory_order_relaxed);
+			}
+		};
+		struct Bucket { Slot deep, always; };
+
+		std::unique_ptr<Bucket[]> table;
+		size_t buckets = 0;
+		uint64_t mask = 0;
+		uint8_t generation = 0;
+
+		// table takes at most `mb` megabytes (rounded down to power of two buckets).
+		TransTable(size_t mb = 64) { resize(mb); }
+
+		void resize(size_t mb) {
+			size_t count = 1, limit = std::max<size_t>(mb, 1) * 1024 * 1024 / sizeof(Bucket);
+			while ((count << 1) <= limit) count <<= 1;
+			table.reset();
+			table.reset(new Bucket[count]);
+			buckets = count;
+			mask = count - 1;
+		}
+		size_t megabytes() const { return buckets * sizeof(Bucket) / (1024 * 1024); }
+		void clear() {
+			for (size_t k = 0; k < buckets; k++) table[k].deep.save(Entry()), table[k].always.save(Entry());
+			generation = 0;
+		}
+		// marks start of new search, entries stored before become candidates for replacement.
+		// must not run while searching threads are using the table.
+		void newSearch() { generation = (generation + 1) & 63; }
+
+		bool probe(uint64_t key, Entry &out) const {
+			const Bucket &b = table[key & mask];
+			Entry e = b.deep.load();
+			if (e.bound() != BOUND_NONE && e.key == key) { out = e; return true; }
+			e = b.always.load();
+			if (e.bound() != BOUND_NONE && e.key == key) { out = e; return true; }
+			return false;
+		}
+		void store(uint64_t key, int value, int depth, Bound bound, int move = -1) {
+			Bucket &b = table[key & mask];
+			Entry deep = b.deep.load(), always = b.always.load();
+			bool deepSame = deep.bound() != BOUND_NONE && deep.key == key;
+			bool alwaysSame = always.bound() != BOUND_NONE && always.key == key;
+			// keep old best move when new search did not produce one.
+			if (move < 0) {
+				if (deepSame) move = deep.move;
+				else if (alwaysSame) move = always.move;
+			}
+
+			Entry e;
+			e.key = key; e.value = value; e.move = int16_t(move); e.depth = int8_t(depth);
+			e.genbound = uint8_t(generation << 2 | bound);
+			if (deep.bound() == BOUND_NONE || deep.gen() != generation || depth >= deep.depth) {
+				// shallower copy of the same position would only shadow the new one.
+				if (alwaysSame) b.always.save(Entry());
+				b.deep.save(e);
+			}
+			else b.always.save(e);
+		}
+	};
+}
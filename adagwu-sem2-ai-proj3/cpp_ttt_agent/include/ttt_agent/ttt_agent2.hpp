@@ -1,23 +1,165 @@
+#pragma once
 #include <vector>
-#include <unordered_map>
+#include <climits>
+#include <cstdint>
+#include <cstring>
 #include <string>
 #include <thread>
 #include <chrono>
 #include <algorithm>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "transposition.hpp"
+#include "patterns.hpp"
 
 namespace ttt_agent {
 	struct pii { int i; int j; };
 	struct piii { pii best_move = {-1, -1}; int best_score = INT_MIN; };
 	const char X = 'X', O = 'O', E = '.';
-	const int WIN_SCORE = 100;
-	const int LOSE_SCORE = -100;
+	const int WIN_SCORE = 1000000;
+	const int LOSE_SCORE = -1000000;
+	// biggest supported board side. every line of the board is kept in one 64 bit word,
+	// so runs can be shifted past the far edge without overflowing.
+	const int MAX_N = 32;
+	const int MAX_LINES = 2 * MAX_N - 1;
+	const int MAX_CELLS = MAX_N * MAX_N;
+	// candidate moves are empty cells within this (chebyshev) distance of some stone.
+	const int FRONTIER_RADIUS = 1;
+	// rotations and reflections of the square board (dihedral group).
+	const int SYMMETRIES = 8;
+	// half width of root aspiration window around previous iteration score (with `pvs`).
+	const int ASPIRATION = 64;
+	// late move reductions (with `lmr`): quiet moves after the first `LMR_MOVES` ones at remaining depth
+	// of at least `LMR_DEPTH` are searched one ply shallower (two after `2 * LMR_MOVES + 6` moves).
+	const int LMR_MOVES = 3;
+	const int LMR_DEPTH = 3;
+	// deepest iteration a transposition entry can record (its depth is 8 bit), the cap of `-dynamic 1`.
+	const int MAX_DEPTH = 127;
+
+	typedef uint64_t line_t;
+
+	// index of the lowest set bit, `x` must not be 0.
+	inline int bitLow(line_t x) {
+	#if defined(_MSC_VER)
+		unsigned long r; _BitScanForward64(&r, x); return (int)r;
+	#else
+		return __builtin_ctzll(x);
+	#endif
+	}
+	// index of the highest set bit, `x` must not be 0.
+	inline int bitHigh(line_t x) {
+	#if defined(_MSC_VER)
+		unsigned long r; _BitScanReverse64(&r, x); return (int)r;
+	#else
+		return 63 - __builtin_clzll(x);
+	#endif
+	}
+	// number of consecutive set bits starting at bit `b` and going up.
+	inline int runUp(line_t x, int b) { return bitLow(~(x >> b)); }
+	// number of consecutive set bits right below bit `b` going down.
+	inline int runDown(line_t x, int b) {
+		line_t y = ~x & ((line_t(1) << b) - 1);
+		return y ? b - 1 - bitHigh(y) : b;
+	}
+
+	inline uint64_t splitmix64(uint64_t &state) {
+		uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+
+	// random key for every (player, cell), board hash is xor of keys of all placed stones.
+	struct Zobrist {
+		uint64_t keys[2][MAX_N * MAX_N];
+		// mixed into the search key for the move that led to position when leaf scores depend on it (no pattern tables).
+		uint64_t last[MAX_N * MAX_N];
+		// mixed into the search key when minimizing side is to move.
+		uint64_t side;
+		Zobrist() {
+			uint64_t state = 1447;
+			for (auto &player: keys) for (auto &key: player) key = splitmix64(state);
+			for (auto &key: last) key = splitmix64(state);
+			side = splitmix64(state);
+		}
+	};
+	inline const Zobrist zobrist;
 
 	struct Board {
-		std::vector<std::vector<char> > g;
+		// walking directions, bit index of a cell grows when moving along `dirs[d]` on line `lineOf(d, ..)`.
+		static constexpr int dirs[4][2] = { {0, 1}, {1, 0}, {1, 1}, {1, -1} };
+
+		// lines[player][d][line] - stones of the player, one word per row, column, diagonal and anti-diagonal.
+		line_t lines[2][4][MAX_LINES];
+		// cells that exist on board for each line (diagonals are shorter than n).
+		line_t valid[4][MAX_LINES];
 		pii lastmove = {-1, -1};
-		int n, m, size, center;
+		int n, m, size, center, stones = 0;
+		// cells of the stones in the order they were made, so `undo()` puts `lastmove` back
+		// (stones have to be taken back in reverse order).
+		int16_t played[MAX_CELLS];
+		// zobrist hash of stones, updated by `make()`/`undo()`.
+		uint64_t hash = 0;
+		// hashes of the board turned by every symmetry (`symHash[0] == hash`), kept the same way.
+		uint64_t symHash[SYMMETRIES];
+		// candidate frontier kept by `make()`/`undo()`: near[cell] counts stones within `FRONTIER_RADIUS`,
+		// empty cells with non zero count are listed in `frontier` (unordered), slot[cell] is index there or -1.
+		uint8_t near[MAX_CELLS];
+		int16_t slot[MAX_CELLS];
+		int16_t frontier[MAX_CELLS];
+		int frontierSize = 0;
+		// threat tables for `m` (nullptr when `m` is too long, then dangers are found by scans).
+		const PatternTable *pattern;
+		// pat[d][cell] - threat class of the stone at cell along direction `d`,
+		// threats[player][class] - how many (stone, direction) pairs of the player are in that class.
+		// both are kept by `make()`/`undo()` for stones within `m - 1` of the changed cell.
+		uint8_t pat[4][MAX_CELLS];
+		int threats[2][THREAT_COUNT];
+		// weights of threat classes in `evaluate()`, every stone of a pattern adds one.
+		static constexpr int threatWeight[THREAT_COUNT] = { 0, 1, 4, 6, 24, 32, 400, 4000 };
 
-		Board(int n, int m): n(n), m(m) { g.assign(n, std::vector<char>(n, E)); size = n * n; center = (n >> 1); }
+		Board(int n, int m): n(n), m(m) {
+			size = n * n; center = (n >> 1);
+			pattern = patternTable(m);
+			memset(lines, 0, sizeof(lines));
+			memset(valid, 0, sizeof(valid));
+			memset(near, 0, sizeof(near));
+			memset(slot, -1, sizeof(slot));
+			memset(pat, T_NONE, sizeof(pat));
+			memset(threats, 0, sizeof(threats));
+			memset(symHash, 0, sizeof(symHash));
+			for (int i = 0; i < n; i++) for (int j = 0; j < n; j++) {
+				for (int d = 0; d < 4; d++) valid[d][lineOf(d, i, j)] |= line_t(1) << bitOf(d, i, j);
+			}
+		}
+
+		static int player(char p) { return p == X ? 0 : 1; }
+		int lineOf(int d, int i, int j) const {
+			switch (d) {
+				case 0: return i;
+				case 1: return j;
+				case 2: return i - j + n - 1;
+				default: return i + j;
+			}
+		}
+		static int bitOf(int d, int i, int j) { return d == 0 ? j : i; }
+		// board size independent cell number, used for hash keys and stored moves.
+		static int cellOf(const pii &move) { return move.i * MAX_N + move.j; }
+		static pii moveOf(int cell) { return {cell / MAX_N, cell % MAX_N}; }
+		// cell `k` steps away from `move` along `dirs[d]`.
+		static pii stepFrom(const pii &move, int d, int k) { return {move.i + dirs[d][0] * k, move.j + dirs[d][1] * k}; }
+
+		char at(int i, int j) const {
+			if (lines[0][0][i] >> j & 1) return X;
+			if (lines[1][0][i] >> j & 1) return O;
+			return E;
+		}
 
 		std::string display() const {
 			static std::vector<std::string> numbers;
@@ -33,53 +175,153 @@ namespace ttt_agent {
 			for (int i = 0; i <= n; i++) result.append(numbers[i]);
 			for (int i = 0; i < n; i++) {
 				result.append(numbers[i]);
-				for (auto c: g[i]) result.push_back(c), result.push_back(' '), result.push_back(' ');
+				for (int j = 0; j < n; j++) result.push_back(at(i, j)), result.push_back(' '), result.push_back(' ');
 				result.push_back('\n');
 			}
 			
 			result.push_back('\n');
 			return result;
 		}
+		// cell `move` goes to under symmetry `s`: bit 0 transposes, bit 1 flips rows, bit 2 flips columns.
+		pii transform(pii move, int s) const {
+			if (s & 1) std::swap(move.i, move.j);
+			if (s & 2) move.i = n - 1 - move.i;
+			if (s & 4) move.j = n - 1 - move.j;
+			return move;
+		}
+		pii untransform(pii move, int s) const {
+			if (s & 2) move.i = n - 1 - move.i;
+			if (s & 4) move.j = n - 1 - move.j;
+			if (s & 1) std::swap(move.i, move.j);
+			return move;
+		}
+		// symmetry that turns the board into its canonical orientation (smallest hash), same for all 8 images.
+		int canonical() const {
+			int best = 0;
+			for (int s = 1; s < SYMMETRIES; s++) if (symHash[s] < symHash[best]) best = s;
+			return best;
+		}
+		// stored cell numbers are in the orientation of symmetry `s`, -1 stays as it is.
+		int toStored(int cell, int s) const { return cell < 0 || !s ? cell : cellOf(transform(moveOf(cell), s)); }
+		int fromStored(int cell, int s) const { return cell < 0 || !s ? cell : cellOf(untransform(moveOf(cell), s)); }
+		// transposition key of position reached by `move` with minimizing (`ismin`) or maximizing side to move,
+		// taken in orientation of symmetry `s` (`canonical()` makes all 8 images share one key).
+		// with pattern tables the last move changes no value: the leaf score is `evaluate()` of the position, and
+		// a five, open four or double four of the side which just moved cannot be older than that move (the side
+		// had a four to finish a ply earlier). without them the leaf score is the danger of the last move.
+		uint64_t searchKey(const pii &move, bool ismin, int s = 0) const {
+			uint64_t key = symHash[s] ^ (ismin ? zobrist.side : 0);
+			return pattern ? key : key ^ zobrist.last[toStored(cellOf(move), s)];
+		}
 		std::string boardKey() const {
 			std::string s;
 			s.reserve(size);
-			for (auto &r: g) for(auto c: r) s.push_back(c);
+			for (int i = 0; i < n; i++) for (int j = 0; j < n; j++) s.push_back(at(i, j));
 			return s;
 		}
 
-		void make(pii move, char p) { g[move.i][move.j] = p; lastmove = move; }
-		void undo(pii move) { g[move.i][move.j] = E; }
+		void frontierAdd(int cell) {
+			slot[cell] = int16_t(frontierSize);
+			frontier[frontierSize++] = int16_t(cell);
+		}
+		void frontierRemove(int cell) {
+			int last = frontier[--frontierSize];
+			frontier[slot[cell]] = int16_t(last);
+			slot[last] = slot[cell];
+			slot[cell] = -1;
+		}
 
-		bool inBounds(int i, int j) const { return (i >= 0 && j >= 0 && i < n && j < n); }
-		bool full() const {
-			for(auto &r: g) for(auto c: r) if(c==E)return false; return true;
+		// threat class of (own or hypothetical) stone of player `pl` at bit `b` of line `l` in direction `d`.
+		// `gain` receives offset (along the line) of its winning or upgrading cell.
+		int lineThreat(int d, int l, int b, int pl, int *gain = nullptr) const {
+			line_t at = line_t(1) << b;
+			line_t own = lines[pl][d][l] | at;
+			line_t blocked = (lines[pl ^ 1][d][l] | ~valid[d][l]) & ~at;
+			int lo = b - m + 1, width = 2 * m - 1;
+			// cells before the start of line are blocked.
+			if (lo < 0) own <<= -lo, blocked = (blocked << -lo) | ((line_t(1) << -lo) - 1);
+			else own >>= lo, blocked >>= lo;
+			line_t window = (line_t(1) << width) - 1;
+			int idx = pattern->index(uint32_t(own & window), uint32_t(blocked & window));
+			if (gain) *gain = pattern->gain[idx];
+			return pattern->threat[idx];
 		}
-		bool isMoveWin(const pii &move) const {
-			int dirs[4][2] = { {0, 1}, {1, 0}, {1, 1}, {1, -1} };
-			char p = g[move.i][move.j];
-			for (auto &d: dirs) {
-				int cnt = 1;
-				pii line = move;
-				for (int i = 1; i < m; i++) {
-					line.i += d[0];
-					line.j += d[1];
-					if (line.i < 0 || line.j < 0 || line.i >= n || line.j >= n) break;
-					if (g[line.i][line.j] == p) cnt++;
-					else break;
+		// strongest class a stone of `pl` would get at empty `move`.
+		int threatAt(const pii &move, int pl) const {
+			int best = T_NONE;
+			for (int d = 0; d < 4; d++) best = std::max(best, lineThreat(d, lineOf(d, move.i, move.j), bitOf(d, move.i, move.j), pl));
+			return best;
+		}
+		// recomputes classes of stones on the lines through `move` that it can affect.
+		void refreshThreats(const pii &move) {
+			for (int d = 0; d < 4; d++) {
+				int l = lineOf(d, move.i, move.j), b = bitOf(d, move.i, move.j);
+				int lo = std::max(0, b - m + 1), hi = b + m - 1;
+				line_t first = lines[0][d][l];
+				line_t near = (first | lines[1][d][l]) & ((line_t(2) << hi) - 1) & ~((line_t(1) << lo) - 1);
+				for (; near; near &= near - 1) {
+					int k = bitLow(near), pl = (first >> k & 1) ? 0 : 1;
+					uint8_t t = uint8_t(lineThreat(d, l, k, pl)), &old = pat[d][cellOf(stepFrom(move, d, k - b))];
+					if (t == old) continue;
+					threats[pl][old]--;
+					threats[pl][t]++;
+					old = t;
 				}
-	
-				d[0] = -d[0];
-				d[1] = -d[1];
-				line = move;
-				for (int i = 1; i < m; i++) {
-					line.i += d[0];
-					line.j += d[1];
-					if (line.i < 0 || line.j < 0 || line.i >= n || line.j >= n) break;
-					if (g[line.i][line.j] == p) cnt++;
-					else break;
+			}
+		}
+
+		void make(pii move, char p) {
+			int pl = player(p), cell = cellOf(move);
+			for (int d = 0; d < 4; d++) lines[pl][d][lineOf(d, move.i, move.j)] |= line_t(1) << bitOf(d, move.i, move.j);
+			hash ^= zobrist.keys[pl][cell];
+			for (int s = 0; s < SYMMETRIES; s++) symHash[s] ^= zobrist.keys[pl][cellOf(transform(move, s))];
+			played[stones++] = int16_t(cell);
+			lastmove = move;
+			if (pattern) threats[pl][T_NONE] += 4, refreshThreats(move);
+
+			if (slot[cell] >= 0) frontierRemove(cell);
+			for (int i = std::max(0, move.i - FRONTIER_RADIUS); i <= std::min(n - 1, move.i + FRONTIER_RADIUS); i++) {
+				for (int j = std::max(0, move.j - FRONTIER_RADIUS); j <= std::min(n - 1, move.j + FRONTIER_RADIUS); j++) {
+					int c = i * MAX_N + j;
+					if (c != cell && !near[c]++ && at(i, j) == E) frontierAdd(c);
+				}
+			}
+		}
+		void undo(pii move) {
+			char p = at(move.i, move.j);
+			if (p == E) return;
+			int cell = cellOf(move);
+			for (int d = 0; d < 4 && pattern; d++) threats[player(p)][pat[d][cell]]--, pat[d][cell] = T_NONE;
+			for (int d = 0; d < 4; d++) {
+				line_t mask = ~(line_t(1) << bitOf(d, move.i, move.j));
+				int l = lineOf(d, move.i, move.j);
+				lines[0][d][l] &= mask;
+				lines[1][d][l] &= mask;
+			}
+			if (pattern) refreshThreats(move);
+			hash ^= zobrist.keys[player(p)][cell];
+			for (int s = 0; s < SYMMETRIES; s++) symHash[s] ^= zobrist.keys[player(p)][cellOf(transform(move, s))];
+			stones--;
+			lastmove = stones ? moveOf(played[stones - 1]) : pii{-1, -1};
+
+			for (int i = std::max(0, move.i - FRONTIER_RADIUS); i <= std::min(n - 1, move.i + FRONTIER_RADIUS); i++) {
+				for (int j = std::max(0, move.j - FRONTIER_RADIUS); j <= std::min(n - 1, move.j + FRONTIER_RADIUS); j++) {
+					int c = i * MAX_N + j;
+					if (c != cell && !--near[c] && slot[c] >= 0) frontierRemove(c);
 				}
-	
-				if (cnt >= m) return true;
+			}
+			if (near[cell]) frontierAdd(cell);
+		}
+
+		bool inBounds(int i, int j) const { return (i >= 0 && j >= 0 && i < n && j < n); }
+		bool full() const { return stones >= size; }
+		bool isMoveWin(const pii &move) const {
+			char p = at(move.i, move.j);
+			if (p == E) return false;
+			for (int d = 0; d < 4; d++) {
+				line_t own = lines[player(p)][d][lineOf(d, move.i, move.j)];
+				int b = bitOf(d, move.i, move.j);
+				if (runUp(own, b) + runDown(own, b) >= m) return true;
 			}
 			return false;
 		}
@@ -87,13 +329,24 @@ namespace ttt_agent {
 		// returns `0` if there no danger for oponent of this move
 		// gives number of `1 step from winning` scenarios for this move (maximum `8`, as per number of directions, yet more than 2 is already game ending move)
 		// gives `INT_MAX` instead when move is game winning and therefor game ending one.
+		// with pattern tables a danger is a four (one winning cell) and open four counts as two.
 		int checkAllDangers(const pii &move, pii &endpoint, char p = E) const {
-			int dirs[4][2] = { {0, 1}, {1, 0}, {1, 1}, {1, -1} };
 			int dangers = 0;
 
-			if (p == E) p = g[move.i][move.j];
-			for (auto &dir: dirs) {
-				int danger = moveDirectionDangers(move, endpoint, dir[0], dir[1], p);
+			if (p == E) p = at(move.i, move.j);
+			if (pattern) {
+				if (p == E) return 0;
+				for (int d = 0; d < 4; d++) {
+					int gain, t = lineThreat(d, lineOf(d, move.i, move.j), bitOf(d, move.i, move.j), player(p), &gain);
+					if (t == T_FIVE) return INT_MAX;
+					if (t < T_FOUR) continue;
+					endpoint = stepFrom(move, d, gain);
+					dangers += t == T_OPEN_FOUR ? 2 : 1;
+				}
+				return dangers >= 2 ? INT_MAX : dangers;
+			}
+			for (int d = 0; d < 4; d++) {
+				int danger = moveDirectionDangers(move, endpoint, d, p);
 				if (danger == -1) return INT_MAX;
 				dangers += danger;
 			}
@@ -101,59 +354,36 @@ namespace ttt_agent {
 			if (dangers >= 2) return INT_MAX;
 			return dangers;
 		}
-		int moveDirectionDangers(const pii &move, pii &endpoint2, int dx, int dy, char p = E) const {
-			int cnt = 1, dangers = 0, total, px, py, i;
+		int checkAllDangers(const pii &move, char p = E) const { pii endpoint; return checkAllDangers(move, endpoint, p); }
+		// same as one direction of `checkAllDangers`, but scans are done on line words:
+		// at most `m - 1` cells are looked at on each side, and one empty cell (gap) is allowed inside.
+		int moveDirectionDangers(const pii &move, pii &endpoint2, int d, char p = E) const {
+			if (p == E) p = at(move.i, move.j);
+			int l = lineOf(d, move.i, move.j), b = bitOf(d, move.i, move.j), reach = m - 1;
+			line_t own = lines[player(p)][d][l];
+			line_t empty = valid[d][l] & ~(lines[0][d][l] | lines[1][d][l]);
+			int up = std::min(runUp(own, b + 1), reach);
+			int down = std::min(runDown(own, b), reach);
+			int cnt = 1 + up + down, dangers = 0, isgap = 0, total, gap;
 			pii endpoint1 = {-1, -1};
-			int isgap = 0;
-
-			px = move.i; py = move.j;
-			for (i = 1; i < m; i++) {
-				px += dx; py += dy;
-				if (!inBounds(px, py)) break;
-				if (g[px][py] == p) cnt++;
-				else {
-					if (g[px][py] == E) endpoint1 = {px, py}, isgap |= 1;
-					break;
-				}
-			}
 
-			total = cnt;
-			if (isgap & 1) {
-				for (i++; i < m; i++) {
-					px += dx; py += dy;
-					if (!inBounds(px, py)) break;
-					if (g[px][py] == p) total++;
-					else break;
-				}
+			total = 1 + up;
+			gap = b + up + 1;
+			if (up < reach && (empty >> gap & 1)) {
+				endpoint1 = stepFrom(move, d, up + 1), isgap |= 1;
+				total += std::min(runUp(own, gap + 1), reach - up - 1);
 			}
-
 			if (total + 1 >= m && isgap) {
 				dangers++;
 				endpoint2 = endpoint1;
 			}
 
-			dx = -dx; dy = -dy;
-			px = move.i; py = move.j;
-			for (i = 1; i < m; i++) {
-				px += dx; py += dy;
-				if (!inBounds(px, py)) break;
-				if (g[px][py] == p) cnt++;
-				else {
-					if (g[px][py] == E) endpoint1 = {px, py}, isgap |= 2;
-					break;
-				}
-			}
-			
 			total = cnt;
-			if (isgap & 2) {
-				for (i++; i < m; i++) {
-					px += dx; py += dy;
-					if (!inBounds(px, py)) break;
-					if (g[px][py] == p) total++;
-					else break;
-				}
+			gap = b - down - 1;
+			if (down < reach && gap >= 0 && (empty >> gap & 1)) {
+				endpoint1 = stepFrom(move, d, -down - 1), isgap |= 2;
+				total += std::min(runDown(own, gap), reach - down - 1);
 			}
-
 			if (total + 1 >= m && isgap) {
 				dangers++;
 				endpoint2 = endpoint1;
@@ -163,6 +393,13 @@ namespace ttt_agent {
 			return dangers;
 		}
 
+		// weighted threat classes of player `p` minus the ones of the opponent (needs pattern tables).
+		int evaluate(char p) const {
+			int pl = player(p), score = 0;
+			for (int k = T_TWO; k < THREAT_COUNT; k++) score += threatWeight[k] * (threats[pl][k] - threats[pl ^ 1][k]);
+			return score;
+		}
+
 		// Lower Manhattan distance from the center gets a higher (less negative) is value.
 		int heuristic2(const pii &move) const {
 			int di = abs(move.i - center);
@@ -170,243 +407,686 @@ namespace ttt_agent {
 			return -(di + dj);
 		}
 
-		std::vector<pii> getCandidateMoves(int radius = 1) const {
+		// frontier cells written to `out` (room for `frontierSize` moves), closer to the center first.
+		// counting sort over manhattan distance, so cost is number of candidates plus n.
+		int candidates(pii *out) const {
+			int count[2 * MAX_N + 1] = {0}, distance[MAX_CELLS];
+			for (int k = 0; k < frontierSize; k++) {
+				pii move = moveOf(frontier[k]);
+				count[distance[k] = -heuristic2(move)]++;
+			}
+			for (int k = 0, total = 0; k <= 2 * n; k++) std::swap(count[k], total), total += count[k];
+			for (int k = 0; k < frontierSize; k++) out[count[distance[k]]++] = moveOf(frontier[k]);
+			return frontierSize;
+		}
+
+		// empty cells within `radius` (chebyshev distance) of any stone.
+		// default radius is read from the incremental frontier, other ones dilate occupied rows as words.
+		std::vector<pii> getCandidateMoves(int radius = FRONTIER_RADIUS) const {
 			std::vector<pii> candidates;
-			std::vector<std::vector<bool> > g2(n, std::vector<bool>(n, false));
-	
+			if (radius == FRONTIER_RADIUS) {
+				candidates.resize(frontierSize);
+				this->candidates(candidates.data());
+				return candidates;
+			}
+
+			line_t occupied[MAX_N];
+			for (int i = 0; i < n; i++) occupied[i] = lines[0][0][i] | lines[1][0][i];
+
 			for (int i = 0; i < n; i++) {
-				for (int j = 0; j < n; j++) {
-					if (g[i][j] == E) continue;					
-
-					for (int  di = -radius; di <= radius; di++) {
-						for (int dj = -radius; dj <= radius; dj++) {
-							int ni = i + di, nj = j + dj;
-							if (!inBounds(ni, nj) || g2[ni][nj] || g[ni][nj] != E) continue;
-							g2[ni][nj] = 1;
-							candidates.push_back({ni, nj});
-						}
-					}
-				}
+				line_t rows = 0;
+				for (int k = std::max(0, i - radius); k <= std::min(n - 1, i + radius); k++) rows |= occupied[k];
+				line_t near = rows;
+				for (int k = 1; k <= radius; k++) near |= (rows << k) | (rows >> k);
+				near &= valid[0][i] & ~occupied[i];
+				for (; near; near &= near - 1) candidates.push_back({i, bitLow(near)});
 			}
 
-			sort(candidates.begin(), candidates.end(), [this](const pii &a, const pii &b) {
+			std::stable_sort(candidates.begin(), candidates.end(), [this](const pii &a, const pii &b) {
 				return heuristic2(a) > heuristic2(b);
-				// static char p = g[lastmove.i][lastmove.j] == X ? O : X;
-				// return checkAllDangers(a, pii(), p) > checkAllDangers(b, pii(), p);
 			});
 			return candidates;
 		}
 	};
 
+	// move ordering learned from cutoffs: two killer moves for every number of stones on board
+	// (same as ply inside one search), and butterfly history of cutoff moves per player and cell.
+	struct MoveOrder {
+		int16_t killers[MAX_CELLS + 1][2];
+		int history[2][MAX_CELLS];
+
+		MoveOrder() { clear(); }
+		void clear() {
+			memset(killers, -1, sizeof(killers));
+			memset(history, 0, sizeof(history));
+		}
+		// new search keeps half of the old history, killers stay (their plies are still ahead).
+		void age() {
+			for (auto &player: history) for (auto &h: player) h >>= 1;
+		}
+		void cutoff(int stones, int pl, int cell, int depth) {
+			int16_t *k = killers[stones];
+			if (k[0] != cell) k[1] = k[0], k[0] = int16_t(cell);
+			history[pl][cell] = std::min(history[pl][cell] + depth * depth, (1 << 27));
+		}
+		// hash move, killers, then moves by history. ties keep the given (distance to center) order.
+		// `keyed` is scratch room for `count` keys.
+		void sort(pii *moves, int count, int hashmove, int stones, int pl, uint64_t *keyed) const {
+			const int16_t *k = killers[stones];
+			for (int i = 0; i < count; i++) {
+				int cell = Board::cellOf(moves[i]);
+				uint64_t score = cell == hashmove ? (1 << 30) : cell == k[0] ? (1 << 29) : cell == k[1] ? (1 << 28) : history[pl][cell];
+				keyed[i] = score << 32 | uint64_t(MAX_CELLS - i) << 16 | uint64_t(cell);
+			}
+			std::sort(keyed, keyed + count, std::greater<uint64_t>());
+			for (int i = 0; i < count; i++) moves[i] = Board::moveOf(int(keyed[i] & 0xFFFF));
+		}
+	};
+
+	// move lists of a search, one buffer with room for every cell per ply (stones above the root), so deep
+	// searches do not grow the thread stack. buffers are made the first time a ply is reached and kept,
+	// later searches of the same player do not allocate. a copy starts empty, they are one thread's scratch space.
+	struct MoveStack {
+		MoveStack() = default;
+		MoveStack(const MoveStack &) {}
+		MoveStack &operator=(const MoveStack &) { return *this; }
+
+		// search starts at position `B`.
+		void reset(const Board &B) {
+			if (width != B.size) plies.clear(), keyed.assign(B.size, 0), width = B.size;
+			base = B.stones;
+		}
+		// moves of position `B`, valid until the search goes back above it.
+		pii *at(const Board &B) {
+			if (width != B.size) reset(B);
+			size_t ply = B.stones - base;
+			if (ply >= plies.size()) plies.resize(ply + 1);
+			if (!plies[ply]) plies[ply].reset(new pii[width]);
+			return plies[ply].get();
+		}
+		// keys for `MoveOrder::sort()`, which is done before the next ply needs them.
+		uint64_t *keys() { return keyed.data(); }
+
+	private:
+		std::vector<std::unique_ptr<pii[]> > plies;
+		std::vector<uint64_t> keyed;
+		int width = 0, base = 0;
+	};
+
+	struct MctsTree;
+	struct OpeningBook;
+	struct SearchHelpers;
+
+	// counters of one search summed over its threads. `iterations` has (elapsed ms, nodes so far) after
+	// every completed depth of the main thread, `threadNodes` the nodes (playouts for mcts) of every thread.
+	struct SearchStats {
+		long long ttProbes = 0, ttHits = 0, ttCutoffs = 0;
+		// nodes which failed high or low, and those where the first searched move did it.
+		long long cutoffs = 0, firstCutoffs = 0;
+		std::vector<std::pair<long long, long long> > iterations;
+		std::vector<long long> threadNodes;
+
+		// vectors keep their storage, so searches after the first do not allocate here.
+		void clear() {
+			ttProbes = ttHits = ttCutoffs = cutoffs = firstCutoffs = 0;
+			iterations.clear();
+			threadNodes.clear();
+		}
+		void add(const SearchStats &o) {
+			ttProbes += o.ttProbes;
+			ttHits += o.ttHits;
+			ttCutoffs += o.ttCutoffs;
+			cutoffs += o.cutoffs;
+			firstCutoffs += o.firstCutoffs;
+		}
+	};
+
 	struct playerData {
 		Board B;
 		int depth = 10;
 		char opp = X;
 		char car = O;
 		pii mylastmove = {-1, -1};
-		std::unordered_map<std::string, int> cache;
+		// threaded search splits the tree (young brothers wait) instead of running lazy SMP.
+		bool split = false;
+		// principal variation search: zero window for all but the first child, aspiration windows at root.
+		bool pvs = false;
+		// late move reductions, and forward pruning of moves that ignore a four or open three of the opponent.
+		bool lmr = false;
+		bool prune = false;
+		// quiescence search node budget for every horizon position (0 - plain static score there).
+		int quiescence = 0;
+		// monte carlo tree search instead of minimax, its tree is kept between moves.
+		bool mcts = false;
+		std::shared_ptr<MctsTree> tree;
+		// transposition keys of all 8 rotations/reflections of a position are the same.
+		bool symmetry = true;
+		// 1/threatShare of move time goes to threat space search before the main one (0 - off).
+		int threatShare = 8;
+		// kept between moves of the game, copies of playerData share it. made at the configured size where the engine
+		// is set up (`-hash`), players which never search (like a board holder for threat space search) have none.
+		std::shared_ptr<TransTable> tt;
+		// depth of last completed iteration and its principal variation (starts with our move).
+		int searched = 0;
+		std::vector<pii> pv;
+		// set once time limit is hit, everything searched after that is unreliable.
+		bool stop = false;
+		// node budget of one search thread (0 - none). with it the clock is never read, so a search on one thread
+		// always gives the same move for the same position, settings and table contents.
+		long long maxNodes = 0;
+		// time checks left until the next clock read.
+		int clockCheck = 0;
+		// shared by all threads of one parallel search, raised when the main thread is done
+		// or by whichever thread reads the clock past the time limit.
+		std::atomic<bool> *halt = nullptr;
+		// split point of a young brothers wait task, raised when the rest of its siblings are not needed.
+		std::atomic<bool> *cutoff = nullptr;
+		// killers and history of this thread, kept between moves.
+		MoveOrder order;
+		// per ply move lists of this thread.
+		MoveStack moveStack;
+		// positions visited by the last search (all threads).
+		long long nodes = 0;
+		// score of the chosen move for `car` (0 when no search was needed).
+		int score = 0;
+		SearchStats stats;
+		// read only book shared by both sides, nullptr when not loaded.
+		std::shared_ptr<const OpeningBook> book;
+		// lazy smp threads, started by the first threaded search and kept for the game. copies which search
+		// at the same time as this player (other side, pondering, tournament games) must reset it.
+		std::shared_ptr<SearchHelpers> helpers;
 	};
 
 
+	// position reached by `move` (made by maximizing side if `ismin`) is already decided, its score goes to `score`:
+	// last move made five, open four or two fours, or (known from pattern counts) side to move has a four to finish.
+	bool isDecided(const playerData &data, const pii &move, bool ismin, int &score) {
+		const Board &B = data.B;
+		int danger = B.checkAllDangers(move);
+		if (danger == INT_MAX && B.isMoveWin(move)) {
+			score = ismin ? WIN_SCORE : LOSE_SCORE;
+			return true;
+		}
+		const int *next = B.threats[Board::player(ismin ? data.opp : data.car)];
+		if (B.pattern && (next[T_FOUR] || next[T_OPEN_FOUR])) {
+			score = ismin ? LOSE_SCORE : WIN_SCORE;
+			return true;
+		}
+		if (danger == INT_MAX) {
+			score = ismin ? WIN_SCORE : LOSE_SCORE;
+			return true;
+		}
+		return false;
+	}
+	// score of undecided position when search stops at it, for maximizing side.
+	int leafScore(const playerData &data, const pii &move, bool ismin) {
+		if (data.B.pattern) return data.B.evaluate(data.car);
+		int danger = data.B.checkAllDangers(move);
+		return ismin ? danger : -danger;
+	}
+
+	// quiescence at the horizon: side to move may stand pat on the static score or keep making fours,
+	// an opponent four has to be blocked. `budget` is shared by the whole tree below one horizon position,
+	// when it runs out the static score is taken.
+	int quiescence(playerData &data, const pii &move, bool ismin, int alpha, int beta, int &budget) {
+		int decided;
+		if (isDecided(data, move, ismin, decided)) return decided;
+		int stand = leafScore(data, move, ismin);
+		if (!data.B.pattern || data.B.full() || --budget <= 0) return stand;
+
+		const char p = ismin ? data.opp : data.car;
+		const int mover = Board::player(p), *threat = data.B.threats[mover ^ 1];
+		const bool forced = threat[T_FOUR] + threat[T_OPEN_FOUR] > 0;
+		int best = ismin ? INT_MAX : INT_MIN;
+		if (!forced) {
+			best = stand;
+			if (ismin ? stand <= alpha : stand >= beta) return stand;
+			if (ismin) beta = std::min(beta, stand);
+			else alpha = std::max(alpha, stand);
+		}
+
+		pii *moves = data.moveStack.at(data.B);
+		int count = data.B.candidates(moves), kept = 0;
+		for (int k = 0; k < count; k++) {
+			if (forced ? data.B.threatAt(moves[k], mover ^ 1) == T_FIVE : data.B.threatAt(moves[k], mover) >= T_FOUR) moves[kept++] = moves[k];
+		}
+		for (int k = 0; k < kept && beta > alpha; k++) {
+			data.B.make(moves[k], p);
+			data.nodes++;
+			int score = quiescence(data, moves[k], !ismin, alpha, beta, budget);
+			data.B.undo(moves[k]);
+			if (ismin) best = std::min(best, score), beta = std::min(beta, score);
+			else best = std::max(best, score), alpha = std::max(alpha, score);
+		}
+		return best == INT_MAX || best == INT_MIN ? stand : best;
+	}
+	// score where the main search stops: quiescence when enabled, else the static one.
+	int horizonScore(playerData &data, const pii &move, bool ismin, int alpha = INT_MIN, int beta = INT_MAX) {
+		if (data.quiescence <= 0 || data.B.full()) return leafScore(data, move, ismin);
+		int budget = data.quiescence;
+		return quiescence(data, move, ismin, alpha, beta, budget);
+	}
+
+	// time checks between two clock reads.
+	const int CLOCK_CHECKS = 1024;
+
+	// raises `data.stop` once the search has to end: `halt` or `cutoff` is up, node budget is spent,
+	// or (clock read on every `CLOCK_CHECKS` call, never with a budget) `limit` ms since `start` have passed.
+	// the clock also raises `halt`, so threads which have not read it yet stop at their next check.
+	inline bool timeUp(playerData &data, std::chrono::time_point<std::chrono::high_resolution_clock> start, int limit) {
+		if (data.stop) return true;
+		if (data.halt && data.halt->load(std::memory_order_relaxed)) return data.stop = true;
+		if (data.cutoff && data.cutoff->load(std::memory_order_relaxed)) return data.stop = true;
+		if (data.maxNodes) return data.stop = data.nodes >= data.maxNodes;
+		if (--data.clockCheck > 0) return false;
+		data.clockCheck = CLOCK_CHECKS;
+		if (std::chrono::high_resolution_clock::now() - start < std::chrono::milliseconds(limit)) return false;
+		if (data.halt) data.halt->store(true, std::memory_order_relaxed);
+		return data.stop = true;
+	}
+
 	int minimax_alpha_beta(playerData& data, const pii &move, int depth, 
 		std::chrono::time_point<std::chrono::high_resolution_clock> start, int limit = 30000, 
 		bool ismin = true, int alpha = INT_MIN, int beta = INT_MAX) {
-		std::string key = data.B.boardKey();
-		if (data.cache.count(key)) return data.cache[key];
+		data.nodes++;
+		const int sym = data.symmetry ? data.B.canonical() : 0;
+		uint64_t key = data.B.searchKey(move, ismin, sym);
+		TransTable::Entry entry;
+		int hashmove = -1;
+		data.stats.ttProbes++;
+		if (data.tt->probe(key, entry)) {
+			data.stats.ttHits++;
+			hashmove = data.B.fromStored(entry.move, sym);
+			if (entry.depth >= depth && (entry.bound() == BOUND_EXACT || (entry.bound() == BOUND_LOWER && entry.value >= beta)
+				|| (entry.bound() == BOUND_UPPER && entry.value <= alpha))) {
+				data.stats.ttCutoffs++;
+				return entry.value;
+			}
+		}
 
-		int danger = data.B.checkAllDangers(move, pii());
-		if (danger == INT_MAX) return (ismin ? WIN_SCORE : LOSE_SCORE);
-		if (depth == 0 || data.B.full()) return (ismin ? danger : -danger);
+		int decided;
+		if (isDecided(data, move, ismin, decided)) return decided;
+		if (depth == 0 || data.B.full()) return horizonScore(data, move, ismin, alpha, beta);
 
-		int best = ismin ? INT_MAX : INT_MIN;
-		std::vector<pii> moves = data.B.getCandidateMoves();
-		for (pii &nmove: moves) {
-			auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start).count();
-			if (elapsed >= limit) break;
+		int best = ismin ? INT_MAX : INT_MIN, bestmove = -1, searched = 0;
+		const int alpha0 = alpha, beta0 = beta;
+		const int mover = Board::player(ismin ? data.opp : data.car);
+		const int *threat = data.B.threats[mover ^ 1];
+		pii *moves = data.moveStack.at(data.B);
+		int count = data.B.candidates(moves);
+		data.order.sort(moves, count, hashmove, data.B.stones, mover, data.moveStack.keys());
+
+		// opponent four (or open three) on board: nothing is reduced, and with `prune` only moves
+		// that weaken it or make own four are searched.
+		const bool facingFour = threat[T_FOUR] + threat[T_OPEN_FOUR] > 0;
+		int facing = 0;
+		if (data.B.pattern) facing = facingFour ? threat[T_FOUR] + threat[T_OPEN_FOUR] : threat[T_OPEN_THREE];
+		for (int k = 0; k < count; k++) {
+			pii &nmove = moves[k];
+			if (timeUp(data, start, limit)) break;
 			
 			data.B.make(nmove, (ismin ? data.opp : data.car));
-			int score = minimax_alpha_beta(data, nmove, depth - 1, start, limit, !ismin, alpha, beta);
+			int made = T_NONE, cell = Board::cellOf(nmove);
+			for (int d = 0; d < 4 && data.B.pattern; d++) made = std::max(made, int(data.B.pat[d][cell]));
+			if (data.prune && facing && made < T_FOUR && (searched || k + 1 < count)) {
+				int left = facingFour ? threat[T_FOUR] + threat[T_OPEN_FOUR] : threat[T_OPEN_THREE];
+				if (left >= facing) {
+					data.B.undo(nmove);
+					continue;
+				}
+			}
+			searched++;
+
+			// late quiet move: reduced zero window search first, full depth only if it beats the bound.
+			int reduce = data.lmr && !facing && depth >= LMR_DEPTH && k >= LMR_MOVES && made < T_OPEN_THREE ? 1 + (k >= 2 * LMR_MOVES + 6) : 0;
+			int score;
+			bool full = true;
+			if (reduce) {
+				if (ismin) {
+					score = minimax_alpha_beta(data, nmove, depth - 1 - reduce, start, limit, !ismin, beta - 1, beta);
+					full = score < beta;
+				}
+				else {
+					score = minimax_alpha_beta(data, nmove, depth - 1 - reduce, start, limit, !ismin, alpha, alpha + 1);
+					full = score > alpha;
+				}
+				if (data.stop) full = false;
+			}
+			if (full && data.pvs && searched > 1) {
+				// later moves only have to show they are no better than the best one (zero window on own bound),
+				// full window search again when that fails.
+				if (ismin) {
+					score = minimax_alpha_beta(data, nmove, depth - 1, start, limit, !ismin, beta - 1, beta);
+					if (score < beta && score > alpha && !data.stop) score = minimax_alpha_beta(data, nmove, depth - 1, start, limit, !ismin, alpha, beta);
+				}
+				else {
+					score = minimax_alpha_beta(data, nmove, depth - 1, start, limit, !ismin, alpha, alpha + 1);
+					if (score > alpha && score < beta && !data.stop) score = minimax_alpha_beta(data, nmove, depth - 1, start, limit, !ismin, alpha, beta);
+				}
+			}
+			else if (full) score = minimax_alpha_beta(data, nmove, depth - 1, start, limit, !ismin, alpha, beta);
 			data.B.undo(nmove);
 
 			if (ismin) {
-				if (score < best) best = score;
+				if (score < best) best = score, bestmove = Board::cellOf(nmove);
 				if (best < beta) beta = best;
 			}
 			else {
-				if (score > best) best = score;
+				if (score > best) best = score, bestmove = Board::cellOf(nmove);
 				if (best > alpha) alpha = best;
 			}
-			if (beta <= alpha) break;
+			if (beta <= alpha) {
+				data.stats.cutoffs++;
+				data.stats.firstCutoffs += searched == 1;
+				data.order.cutoff(data.B.stones, mover, Board::cellOf(nmove), depth);
+				break;
+			}
 		}
 
-		data.cache[key] = best;
+		// partially searched node says nothing reliable about its value.
+		if (data.stop) return best;
+		Bound bound = best <= alpha0 ? BOUND_UPPER : (best >= beta0 ? BOUND_LOWER : BOUND_EXACT);
+		data.tt->store(key, best, depth, bound, data.B.toStored(bestmove, sym));
 		return best;
 	}
 
 
 	int minimax(playerData& data, const pii &move, int depth, 
 		std::chrono::time_point<std::chrono::high_resolution_clock> start, int limit = 30000, bool ismin = true) {
-		std::string key = data.B.boardKey();
-		if (data.cache.count(key)) return data.cache[key];
+		data.nodes++;
+		const int sym = data.symmetry ? data.B.canonical() : 0;
+		uint64_t key = data.B.searchKey(move, ismin, sym);
+		TransTable::Entry entry;
+		data.stats.ttProbes++;
+		if (data.tt->probe(key, entry)) {
+			data.stats.ttHits++;
+			if (entry.bound() == BOUND_EXACT && entry.depth >= depth) {
+				data.stats.ttCutoffs++;
+				return entry.value;
+			}
+		}
 
-		int danger = data.B.checkAllDangers(move, pii());
-		if (danger == INT_MAX) return (ismin ? WIN_SCORE : LOSE_SCORE);
-		if (depth == 0 || data.B.full()) return (ismin ? danger : -danger);
+		int decided;
+		if (isDecided(data, move, ismin, decided)) return decided;
+		if (depth == 0 || data.B.full()) return horizonScore(data, move, ismin);
 
-		int best = ismin ? INT_MAX : INT_MIN;
-		std::vector<pii> moves = data.B.getCandidateMoves();
-		for (pii &nmove: moves) {
-			auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start).count();
-			if (elapsed >= limit) break;
+		int best = ismin ? INT_MAX : INT_MIN, bestmove = -1;
+		pii *moves = data.moveStack.at(data.B);
+		int count = data.B.candidates(moves);
+		for (int k = 0; k < count; k++) {
+			pii &nmove = moves[k];
+			if (timeUp(data, start, limit)) break;
 
 			data.B.make(nmove, (ismin ? data.opp : data.car));
 			int score = minimax(data, nmove, depth - 1, start, limit, !ismin);
 			data.B.undo(nmove);
 
 			if (ismin) {
-				if (score < best) best = score;
+				if (score < best) best = score, bestmove = Board::cellOf(nmove);
 			}
 			else {
-				if (score > best) best = score;
+				if (score > best) best = score, bestmove = Board::cellOf(nmove);
 			}
 		}
 
-		data.cache[key] = best;
+		if (!data.stop) data.tt->store(key, best, depth, BOUND_EXACT, data.B.toStored(bestmove, sym));
 		return best;
 	}
 
 
-	pii minimaxBest(playerData &p, bool alphabeta = true, int timeLimitMs = 30000) {
-		auto start = std::chrono::high_resolution_clock::now();
-		pii nmove;
-		piii global1;
+	// follows stored best moves starting from position after our root `move`, written to `pv`
+	// (its storage is reused, so once it has grown no search allocates here).
+	void principalVariation(playerData &p, const pii &move, int depth, std::vector<pii> &pv) {
+		pv.clear();
+		pv.push_back(move);
+		TransTable::Entry entry;
+		bool ismin = true;
+		p.B.make(move, p.car);
+		while ((int)pv.size() <= depth) {
+			const int sym = p.symmetry ? p.B.canonical() : 0;
+			if (!p.tt->probe(p.B.searchKey(pv.back(), ismin, sym), entry) || entry.move < 0) break;
+			pii next = Board::moveOf(p.B.fromStored(entry.move, sym));
+			if (!p.B.inBounds(next.i, next.j) || p.B.at(next.i, next.j) != E) break;
+			p.B.make(next, ismin ? p.opp : p.car);
+			pv.push_back(next);
+			ismin = !ismin;
+		}
+		for (auto it = pv.rbegin(); it != pv.rend(); it++) p.B.undo(*it);
+	}
 
+	// answers that need no search: center as the first move, or the endpoint of
+	// a threat made by the last move of either side (block it or finish own line).
+	bool quickMove(playerData &p, pii &move) {
+		pii nmove;
 		if (p.B.lastmove.i == -1) {
-			p.mylastmove = {p.B.n / 2, p.B.n / 2};
-			return p.mylastmove;
+			move = {p.B.n / 2, p.B.n / 2};
+			return true;
 		}
 
-		int danger = p.B.lastmove.i == -1 ? 0 : p.B.checkAllDangers(p.B.lastmove, nmove);
-		if (danger) global1.best_move = nmove;
+		int danger = p.B.checkAllDangers(p.B.lastmove, nmove);
+		if (danger) move = nmove;
 		
 		int danger2 = p.mylastmove.i == -1 ? 0 : p.B.checkAllDangers(p.mylastmove, nmove);
-		if (danger2) global1.best_move = nmove;
-		
-		if (danger || danger2) {
-			p.mylastmove = global1.best_move;
-			return global1.best_move;
-		}
+		if (danger2) move = nmove;
 		
-		std::vector<pii> moves = p.B.getCandidateMoves();
-		long long elapsed;
-		for (pii &move: moves) {
-			elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start).count();
-			if (elapsed >= timeLimitMs) {
-				p.depth--;
-				break;
+		return danger || danger2;
+	}
+
+	// iterative deepening over root moves, depth grows by one from `firstDepth` until `p.depth` or the time limit.
+	// every iteration starts with the previous best move (rest are ordered by previous scores),
+	// deeper plies get the principal variation first from stored hash moves.
+	// result always comes from fully searched moves: interrupted iteration is only used
+	// when at least its first (previous best) move was completed.
+	// `shift` rotates root moves after the best one, so helper threads start from different subtrees.
+	// with `p.pvs` iterations start with an aspiration window around the previous score
+	// (searched again with full window when the result falls outside), and later root moves get zero windows.
+	piii iterativeDeepening(playerData &p, bool alphabeta, 
+		std::chrono::time_point<std::chrono::high_resolution_clock> start, int timeLimitMs, int firstDepth = 1, int shift = 0) {
+		piii global1;
+		p.moveStack.reset(p.B);
+		pii moves[MAX_CELLS];
+		int scores[MAX_CELLS], count = p.B.candidates(moves);
+		std::fill(scores, scores + count, 0);
+		long long elapsed = 0;
+		if (count) global1.best_move = moves[0];
+		p.searched = 0;
+		p.pv.clear();
+		// room for the deepest result up front: a deeper pv (or one copied from a helper thread) does not allocate later.
+		p.pv.reserve(p.depth + 1);
+		p.stats.iterations.reserve(p.depth);
+		p.stop = false;
+		bool widen = false;
+
+		for (int depth = std::min(firstDepth, p.depth); depth <= p.depth && !p.stop; depth++) {
+			int lo = INT_MIN, hi = INT_MAX;
+			if (p.pvs && alphabeta && p.searched && !widen && std::abs(global1.best_score) < WIN_SCORE) {
+				lo = global1.best_score - ASPIRATION;
+				hi = global1.best_score + ASPIRATION;
 			}
-			p.B.make(move, p.car);
-			int score = (alphabeta ? 
-				minimax_alpha_beta(p, move, p.depth, start, timeLimitMs) : 
-				minimax(p, move, p.depth, start, timeLimitMs));
-			p.B.undo(move);
-			if (score > global1.best_score) {
-				global1.best_score = score;
-				global1.best_move = move;
+			widen = false;
+
+			if (shift && count > 2) {
+				int k = 1 + (shift + depth) % (count - 1);
+				std::rotate(moves + 1, moves + k, moves + count);
+				std::rotate(scores + 1, scores + k, scores + count);
 			}
-		}
-		if (elapsed < (timeLimitMs >> 3)) p.depth++;
-		
-		p.cache.clear();
-		p.mylastmove = global1.best_move;
-		return global1.best_move;
-	}
-	
-	struct thread_job {
-		playerData p;
-		piii local1;
-		std::vector<pii> moves;
-	};
 
-	std::vector<thread_job> get_jobes(playerData &p, int workers = 1) {
-		std::vector<thread_job> jobs(workers, thread_job{p});
-		int counter = 0;
+			piii iteration;
+			int done = 0;
+			for (; done < count; done++) {
+				pii &move = moves[done];
+				int alpha = std::max(iteration.best_score, lo), score;
+				p.B.make(move, p.car);
+				if (!alphabeta) score = minimax(p, move, depth, start, timeLimitMs);
+				else if (p.pvs && done) {
+					score = minimax_alpha_beta(p, move, depth, start, timeLimitMs, true, alpha, alpha + 1);
+					if (score > alpha && score < hi && !p.stop) score = minimax_alpha_beta(p, move, depth, start, timeLimitMs, true, alpha, hi);
+				}
+				else score = minimax_alpha_beta(p, move, depth, start, timeLimitMs, true, alpha, hi);
+				p.B.undo(move);
+				if (p.stop) break;
+				scores[done] = score;
+				if (score > iteration.best_score) {
+					iteration.best_score = score;
+					iteration.best_move = move;
+				}
+				if (score >= hi) break;
+			}
+			// outside of aspiration window: same depth again with full window (a fail high move is kept if time is up).
+			bool failed = iteration.best_score <= lo || iteration.best_score >= hi;
+			if (failed && !p.stop) {
+				widen = true;
+				depth--;
+				continue;
+			}
+			if (!done || iteration.best_score <= lo) break;
 
-		for (pii &move: p.B.getCandidateMoves()) {
-			jobs[counter++].moves.push_back(move);
-			if (counter == workers) counter = 0;
+			global1 = iteration;
+			principalVariation(p, global1.best_move, depth, p.pv);
+			if (p.stop) break;
+			p.searched = depth;
+			elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start).count();
+			p.stats.iterations.push_back({elapsed, p.nodes});
+			if (global1.best_score >= WIN_SCORE) break;
+
+			// stable by score, insertion sort needs no buffer (unlike `std::stable_sort`).
+			for (int k = 1; k < count; k++) {
+				pii move = moves[k];
+				int score = scores[k], at = k;
+				for (; at > 0 && scores[at - 1] < score; at--) moves[at] = moves[at - 1], scores[at] = scores[at - 1];
+				moves[at] = move;
+				scores[at] = score;
+			}
 		}
+		return global1;
+	}
 
-		return jobs;
+	pii minimaxBest(playerData &p, bool alphabeta = true, int timeLimitMs = 30000) {
+		auto start = std::chrono::high_resolution_clock::now();
+		p.tt->newSearch();
+		p.order.age();
+		p.searched = 0;
+		p.nodes = 0;
+		p.pv.clear();
+		p.score = 0;
+		p.stats.clear();
+
+		if (quickMove(p, p.mylastmove)) return p.mylastmove;
+		piii result = iterativeDeepening(p, alphabeta, start, timeLimitMs);
+		p.stats.threadNodes = {p.nodes};
+		p.score = result.best_score;
+		p.mylastmove = result.best_move;
+		return p.mylastmove;
 	}
 
-	pii minimaxBestThreading(playerData &p, bool alphabeta = true, int threadNum = 1, int timeLimitMs = 30000) {
-		pii nmove;
-		piii global1;
+	// helper threads of lazy SMP with their own copies of the player, kept between moves, so a search only
+	// refreshes the copies and wakes the threads: nothing is started or allocated per move.
+	struct SearchHelpers {
+		std::vector<playerData> workers;
+		std::vector<piii> results;
+		// job of the current search, read by the workers after `generation` changes.
+		bool alphabeta = true;
+		std::chrono::time_point<std::chrono::high_resolution_clock> start;
+		int timeLimitMs = 0;
 
-		if (p.B.lastmove.i == -1) {
-			p.mylastmove = {p.B.n / 2, p.B.n / 2};
-			return p.mylastmove;
+		SearchHelpers(int count, const playerData &p): workers(count, p), results(count) {
+			for (int k = 0; k < count; k++) threads.emplace_back([this, k] { loop(k); });
 		}
+		~SearchHelpers() {
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				quit = true;
+			}
+			wake.notify_all();
+			for (auto &t: threads) t.join();
+		}
+		int size() const { return (int)workers.size(); }
 
-		int danger = p.B.lastmove.i == -1 ? 0 : p.B.checkAllDangers(p.B.lastmove, nmove);
-		if (danger) global1.best_move = nmove;
-		
-		int danger2 = p.mylastmove.i == -1 ? 0 : p.B.checkAllDangers(p.mylastmove, nmove);
-		if (danger2) global1.best_move = nmove;
-		
-		if (danger || danger2) {
-			p.mylastmove = global1.best_move;
-			return global1.best_move;
+		// every worker runs one iterative deepening of the job, `wait()` returns when all are done.
+		void run() {
+			std::lock_guard<std::mutex> guard(lock);
+			generation++;
+			running = size();
+			wake.notify_all();
+		}
+		void wait() {
+			std::unique_lock<std::mutex> guard(lock);
+			done.wait(guard, [this] { return running == 0; });
 		}
 
+	private:
 		std::vector<std::thread> threads;
-		threads.reserve(threadNum);
-		std::vector<thread_job> jobs = get_jobes(p, threadNum);
-		auto start = std::chrono::high_resolution_clock::now();
+		std::mutex lock;
+		std::condition_variable wake, done;
+		uint64_t generation = 0;
+		int running = 0;
+		bool quit = false;
 
-		for (int i = 0; i < threadNum; i++) {
-			thread_job &job = jobs[i];
-			
-			threads.emplace_back([&job, timeLimitMs, start, alphabeta] {
-				long long elapsed;
-				for (auto& move: job.moves) {
-					elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start).count();
-					if (elapsed >= timeLimitMs) {
-						job.p.depth--;
-						break;
-					}
-					job.p.B.make(move, job.p.car);
-					int score = (alphabeta ? 
-						minimax_alpha_beta(job.p, move, job.p.depth, start, timeLimitMs) : 
-						minimax(job.p, move, job.p.depth, start, timeLimitMs));
-					job.p.B.undo(move);
-					if (score > job.local1.best_score) {
-						job.local1.best_score = score;
-						job.local1.best_move = move;
-					}
+		// worker k is thread k + 1 of the search: odd ones start one ply deeper, each rotates root order differently.
+		void loop(int k) {
+			uint64_t seen = 0;
+			while (true) {
+				{
+					std::unique_lock<std::mutex> guard(lock);
+					wake.wait(guard, [this, seen] { return quit || generation != seen; });
+					if (quit) return;
+					seen = generation;
 				}
-				if (elapsed < (timeLimitMs >> 3)) job.p.depth++;
-			});
-		}
-		for (auto &t: threads) {
-			if (t.joinable()) t.join();
-		}
-		bool islate = false;
-		bool isfast = true;
-		for (int i = 0; i < jobs.size(); i++) {
-			if (jobs[i].local1.best_score > global1.best_score) {
-				global1.best_score = jobs[i].local1.best_score;
-				global1.best_move = jobs[i].local1.best_move;
+				results[k] = iterativeDeepening(workers[k], alphabeta, start, timeLimitMs, 1 + ((k + 1) & 1), k + 1);
+				std::lock_guard<std::mutex> guard(lock);
+				if (--running == 0) done.notify_all();
 			}
-			if (!islate && jobs[i].p.depth < p.depth) islate = true;
-			if (isfast && jobs[i].p.depth == p.depth) isfast = false;
 		}
-		if (islate) p.depth--;
-		else if (isfast) p.depth++;
+	};
 
+	// lazy SMP: every thread runs the same iterative deepening on its own board copy, and all of them
+	// share one transposition table. helpers (odd ones start one ply deeper, each rotates root order differently)
+	// mostly fill the table with results the main thread then finds ready. search ends when the main thread
+	// is done, the move comes from the thread with the deepest completed iteration.
+	pii minimaxBestThreading(playerData &p, bool alphabeta = true, int threadNum = 1, int timeLimitMs = 30000) {
+		auto start = std::chrono::high_resolution_clock::now();
+		p.tt->newSearch();
+		p.order.age();
+		p.searched = 0;
+		p.nodes = 0;
+		p.pv.clear();
+		p.score = 0;
+		p.stats.clear();
+
+		if (quickMove(p, p.mylastmove)) return p.mylastmove;
+
+		threadNum = std::max(threadNum, 1);
+		if (!p.helpers || p.helpers->size() != threadNum - 1) p.helpers = std::make_shared<SearchHelpers>(threadNum - 1, p);
+		SearchHelpers &helpers = *p.helpers;
+		std::atomic<bool> halt(false);
+		// copies reuse their buffers (board, pv, stats), they stop once the main thread is done.
+		for (auto &w: helpers.workers) {
+			w = p;
+			w.helpers.reset();
+			w.halt = &halt;
+		}
+		helpers.alphabeta = alphabeta;
+		helpers.start = start;
+		helpers.timeLimitMs = timeLimitMs;
+		helpers.run();
+		piii main = iterativeDeepening(p, alphabeta, start, timeLimitMs);
+		halt = true;
+		helpers.wait();
+
+		piii global1 = main;
+		p.stats.threadNodes.assign(1, p.nodes);
+		for (int k = 0; k < helpers.size(); k++) {
+			playerData &w = helpers.workers[k];
+			p.nodes += w.nodes;
+			p.stats.add(w.stats);
+			p.stats.threadNodes.push_back(w.nodes);
+			if (w.searched <= p.searched || helpers.results[k].best_move.i == -1) continue;
+			global1 = helpers.results[k];
+			p.searched = w.searched;
+			p.pv = w.pv;
+		}
 
-		p.cache.clear();
+		p.score = global1.best_score;
 		p.mylastmove = global1.best_move;
 		return global1.best_move;
 	}
@@ -0,0 +1,288 @@
+#pragma once
+#include "ttt_agent2.hpp"
+
+#include <deque>
+#include <mutex>
+#include <functional>
+
+namespace ttt_agent {
+	// node whose younger brothers are searched in parallel after the eldest one is done.
+	// siblings share the window, and a beta cutoff cancels all of them together with every split below
+	// (tasks see it as their `cutoff`, the end of the search comes through `halt` shared by all of them).
+	struct SplitPoint {
+		SplitPoint *parent;
+		bool ismin;
+		int alpha, beta, best, bestmove;
+		// position at the split point, siblings copy it. player copies live on the heap, nested splits
+		// would take tens of kilobytes of stack each.
+		std::unique_ptr<playerData> base;
+		std::mutex lock;
+		std::atomic<int> pending{0};
+		std::atomic<bool> cutoff{false};
+		std::vector<SplitPoint *> children;
+
+		SplitPoint(SplitPoint *parent, bool ismin, int alpha, int beta, int best, int bestmove, const playerData &data):
+			parent(parent), ismin(ismin), alpha(alpha), beta(beta), best(best), bestmove(bestmove), base(std::make_unique<playerData>(data)) {
+			if (!parent) return;
+			std::lock_guard<std::mutex> guard(parent->lock);
+			parent->children.push_back(this);
+			if (parent->cutoff) cutoff = true;
+		}
+		~SplitPoint() {
+			if (!parent) return;
+			std::lock_guard<std::mutex> guard(parent->lock);
+			parent->children.erase(std::find(parent->children.begin(), parent->children.end(), this));
+		}
+
+		void cancel() {
+			cutoff = true;
+			std::lock_guard<std::mutex> guard(lock);
+			for (auto child: children) child->cancel();
+		}
+		void window(int &a, int &b) {
+			std::lock_guard<std::mutex> guard(lock);
+			a = alpha; b = beta;
+		}
+		// result of one finished sibling.
+		void update(int score, int move) {
+			bool closed;
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				if (ismin) {
+					if (score < best) best = score, bestmove = move;
+					if (best < beta) beta = best;
+				}
+				else {
+					if (score > best) best = score, bestmove = move;
+					if (best > alpha) alpha = best;
+				}
+				closed = beta <= alpha;
+			}
+			if (closed) cancel();
+		}
+	};
+
+	// work stealing pool. every worker pushes and pops its own tasks at the back of its deque
+	// (newest, smallest subtrees first), idle workers steal from the front of others (oldest, biggest ones).
+	// thread which creates the pool is worker 0 and only works while waiting in `helpUntil()`.
+	struct TaskPool {
+		// `sp` is the split point the task searches a sibling of.
+		struct Task { SplitPoint *sp = nullptr; std::function<void()> run; };
+		// `nodes` and `stats` sum up the tasks this worker ran, only the worker itself writes them.
+		struct Queue { std::mutex lock; std::deque<Task> tasks; long long nodes = 0; SearchStats stats; };
+		std::vector<std::unique_ptr<Queue> > queues;
+		std::vector<std::thread> threads;
+		std::atomic<bool> quit{false};
+		static inline thread_local int self = 0;
+
+		TaskPool(int workers) {
+			workers = std::max(workers, 1);
+			for (int k = 0; k < workers; k++) queues.emplace_back(new Queue());
+			self = 0;
+			for (int k = 1; k < workers; k++) {
+				threads.emplace_back([this, k] {
+					self = k;
+					while (!quit.load(std::memory_order_relaxed)) {
+						if (!runOne()) std::this_thread::yield();
+					}
+				});
+			}
+		}
+		~TaskPool() {
+			quit = true;
+			for (auto &t: threads) {
+				if (t.joinable()) t.join();
+			}
+		}
+
+		void push(SplitPoint *sp, std::function<void()> run) {
+			Queue &q = *queues[self];
+			std::lock_guard<std::mutex> guard(q.lock);
+			q.tasks.push_back({sp, std::move(run)});
+		}
+		// split points of queued tasks stay alive (their owner waits for them), so the chain can be walked.
+		static bool below(const SplitPoint *sp, const SplitPoint *within) {
+			if (!within) return true;
+			for (; sp; sp = sp->parent) {
+				if (sp == within) return true;
+			}
+			return false;
+		}
+		// runs one task under the split point `within` (any task when null).
+		bool runOne(const SplitPoint *within = nullptr) {
+			Task task;
+			int count = (int)queues.size();
+			for (int k = 0; k < count && !task.run; k++) {
+				Queue &q = *queues[(self + k) % count];
+				std::lock_guard<std::mutex> guard(q.lock);
+				if (k == 0) {
+					for (auto it = q.tasks.rbegin(); it != q.tasks.rend(); ++it) {
+						if (below(it->sp, within)) { task = std::move(*it); q.tasks.erase(std::next(it).base()); break; }
+					}
+				}
+				else {
+					for (auto it = q.tasks.begin(); it != q.tasks.end(); ++it) {
+						if (below(it->sp, within)) { task = std::move(*it); q.tasks.erase(it); break; }
+					}
+				}
+			}
+			if (!task.run) return false;
+			task.run();
+			return true;
+		}
+		// waiting thread keeps running tasks (own first) until `pending` of `sp` drops to zero. it only takes tasks
+		// of `sp` and the splits below it: a bigger stolen subtree would hold up the node it waits in,
+		// and every nested task adds its frames to the stack.
+		void helpUntil(SplitPoint &sp) {
+			while (sp.pending.load() > 0) {
+				if (!runOne(&sp)) std::this_thread::yield();
+			}
+		}
+	};
+
+	// below this remaining depth subtrees are too small to be worth a task.
+	const int SPLIT_DEPTH = 3;
+
+	// young brothers wait: same as `minimax_alpha_beta`, but after the eldest child is searched serially
+	// (it sets the window) the rest become tasks of `pool`. `parent` is the split point this node belongs to,
+	// `bestOut` (root only) receives the best cell.
+	int ybwc_alpha_beta(playerData &data, const pii &move, int depth,
+		std::chrono::time_point<std::chrono::high_resolution_clock> start, int limit,
+		bool ismin, int alpha, int beta, TaskPool &pool, SplitPoint *parent = nullptr, int *bestOut = nullptr) {
+		if (depth < SPLIT_DEPTH && !bestOut) return minimax_alpha_beta(data, move, depth, start, limit, ismin, alpha, beta);
+		data.nodes++;
+
+		const int sym = data.symmetry ? data.B.canonical() : 0;
+		uint64_t key = data.B.searchKey(move, ismin, sym);
+		TransTable::Entry entry;
+		int hashmove = -1;
+		data.stats.ttProbes++;
+		if (data.tt->probe(key, entry)) {
+			data.stats.ttHits++;
+			hashmove = data.B.fromStored(entry.move, sym);
+			if (entry.depth >= depth && !bestOut && (entry.bound() == BOUND_EXACT || (entry.bound() == BOUND_LOWER && entry.value >= beta)
+				|| (entry.bound() == BOUND_UPPER && entry.value <= alpha))) {
+				data.stats.ttCutoffs++;
+				return entry.value;
+			}
+		}
+
+		// the root has to name a cell, so a four on board is finished by searching its children.
+		int decided;
+		if (!bestOut && isDecided(data, move, ismin, decided)) return decided;
+		if (depth == 0 || data.B.full()) return horizonScore(data, move, ismin, alpha, beta);
+
+		int best = ismin ? INT_MAX : INT_MIN, bestmove = -1;
+		const int alpha0 = alpha, beta0 = beta;
+		pii *moves = data.moveStack.at(data.B);
+		int count = data.B.candidates(moves);
+		if (!count) return best;
+		data.order.sort(moves, count, hashmove, data.B.stones, Board::player(ismin ? data.opp : data.car), data.moveStack.keys());
+
+		data.B.make(moves[0], (ismin ? data.opp : data.car));
+		best = ybwc_alpha_beta(data, moves[0], depth - 1, start, limit, !ismin, alpha, beta, pool, parent);
+		data.B.undo(moves[0]);
+		bestmove = Board::cellOf(moves[0]);
+		if (ismin) beta = std::min(beta, best);
+		else alpha = std::max(alpha, best);
+		const bool first = beta <= alpha;
+
+		if (!data.stop && beta > alpha && count > 1) {
+			SplitPoint sp(parent, ismin, alpha, beta, best, bestmove, data);
+			sp.pending = count - 1;
+			for (int k = 1; k < count; k++) {
+				pii nmove = moves[k];
+				pool.push(&sp, [&sp, &pool, nmove, depth, start, limit] {
+					if (!sp.cutoff) {
+						auto copy = std::make_unique<playerData>(*sp.base);
+						playerData &local = *copy;
+						local.cutoff = &sp.cutoff;
+						// a task is often shorter than one clock check interval, so it reads the clock at once.
+						local.clockCheck = 0;
+						local.stop = false;
+						local.nodes = 0;
+						local.stats.clear();
+						int a, b;
+						sp.window(a, b);
+						local.B.make(nmove, (sp.ismin ? local.opp : local.car));
+						int score = ybwc_alpha_beta(local, nmove, depth - 1, start, limit, !sp.ismin, a, b, pool, &sp);
+						if (!local.stop) sp.update(score, Board::cellOf(nmove));
+						TaskPool::Queue &own = *pool.queues[TaskPool::self];
+						own.nodes += local.nodes;
+						own.stats.add(local.stats);
+					}
+					sp.pending--;
+				});
+			}
+			pool.helpUntil(sp);
+
+			std::lock_guard<std::mutex> guard(sp.lock);
+			best = sp.best;
+			bestmove = sp.bestmove;
+		}
+
+		// a sibling which ran out of time raised `halt` (its result is missing), a cutoff above reaches `data.cutoff`.
+		timeUp(data, start, limit);
+		if (bestOut) *bestOut = bestmove;
+		// partially searched node says nothing reliable about its value.
+		if (data.stop) return best;
+		Bound bound = best <= alpha0 ? BOUND_UPPER : (best >= beta0 ? BOUND_LOWER : BOUND_EXACT);
+		if (bound == (ismin ? BOUND_UPPER : BOUND_LOWER)) data.stats.cutoffs++, data.stats.firstCutoffs += first;
+		data.tt->store(key, best, depth, bound, data.B.toStored(bestmove, sym));
+		return best;
+	}
+
+	// iterative deepening on top of `ybwc_alpha_beta`, the root position itself is the first split point.
+	pii ybwcBest(playerData &p, int threadNum = 1, int timeLimitMs = 30000) {
+		auto start = std::chrono::high_resolution_clock::now();
+		p.tt->newSearch();
+		p.order.age();
+		p.searched = 0;
+		p.nodes = 0;
+		p.pv.clear();
+		p.score = 0;
+		p.stats.clear();
+
+		if (quickMove(p, p.mylastmove)) return p.mylastmove;
+
+		TaskPool pool(threadNum);
+		// stop flag of the whole search, every task inherits it. a search which comes with one (pondering) keeps it,
+		// so stopping from outside reaches the tasks too.
+		std::atomic<bool> halt(false), *outer = p.halt;
+		if (!outer) p.halt = &halt;
+		// moves are passed by reference, and making the children changes `B.lastmove`.
+		const pii last = p.B.lastmove;
+		p.moveStack.reset(p.B);
+		std::vector<pii> moves = p.B.getCandidateMoves();
+		pii best = moves.size() ? moves[0] : pii{-1, -1};
+		long long elapsed = 0;
+		p.stop = false;
+		for (int depth = 1; depth <= p.depth; depth++) {
+			int cell = -1;
+			int score = ybwc_alpha_beta(p, last, depth + 1, start, timeLimitMs, false, INT_MIN, INT_MAX, pool, nullptr, &cell);
+			if (p.stop || cell < 0) break;
+
+			best = Board::moveOf(cell);
+			p.score = score;
+			p.searched = depth;
+			principalVariation(p, best, depth, p.pv);
+			elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start).count();
+			long long nodes = p.nodes;
+			for (auto &q: pool.queues) nodes += q->nodes;
+			p.stats.iterations.push_back({elapsed, nodes});
+			if (score >= WIN_SCORE) break;
+		}
+		// tasks of every worker, the main thread's own nodes count for worker 0.
+		p.stats.threadNodes.assign(pool.queues.size(), 0);
+		p.stats.threadNodes[0] = p.nodes;
+		for (size_t k = 0; k < pool.queues.size(); k++) {
+			p.nodes += pool.queues[k]->nodes;
+			p.stats.add(pool.queues[k]->stats);
+			p.stats.threadNodes[k] += pool.queues[k]->nodes;
+		}
+
+		p.halt = outer;
+		p.mylastmove = best;
+		return best;
+	}
+}
@@ -1,16 +1,197 @@
 #include "jdevtools/curlcmd.hpp"
 #include "nlohmann/json.hpp"
 #include "ttt_agent/ttt_agent2.hpp"
+#include "ttt_agent/ybwc.hpp"
+#include "ttt_agent/threats.hpp"
+#include "ttt_agent/dfpn.hpp"
+#include "ttt_agent/mcts.hpp"
+#include "ttt_agent/book.hpp"
+#include "ttt_agent/tournament.hpp"
 
+#include <cmath>
 #include <fstream>
 #include <iostream>
+#include <sstream>
 #include <thread>
 
 using namespace ttt_agent;
 std::string apikey = "";
 
 void play_inconsole2(playerData &p, int threadCount = 1, int n = 12, int m = 6,
-		bool isalpha = true, int time = 30000, int online = 0, bool startX = false, bool dynamic = false);
+		bool isalpha = true, int time = 30000, int online = 0, bool startX = false, bool dynamic = false, bool ponder = false, const std::string &statsfile = "");
+
+// search settings of one ai, from the command line (`-vs` ones for the tournament opponent).
+struct Engine {
+	int threads = 0, depth = 4, time = 28000, hash = 64, tss = 8, qs = 0, sym = 1;
+	long long nodes = 0;
+	bool isalpha = true, split = false, mcts = false, pvs = false, lmr = false, prune = false;
+
+	// false if `name` is not an engine option.
+	bool set(const std::string &name, const std::string &value) {
+		if (name == "-threads") threads = std::stoi(value);
+		else if (name == "-split") split = std::stoi(value);
+		else if (name == "-mcts") mcts = std::stoi(value);
+		else if (name == "-time") time = std::stoi(value);
+		else if (name == "-alpha") isalpha = std::stoi(value);
+		else if (name == "-pvs") pvs = std::stoi(value);
+		else if (name == "-lmr") lmr = std::stoi(value);
+		else if (name == "-prune") prune = std::stoi(value);
+		else if (name == "-qs") qs = std::stoi(value);
+		else if (name == "-depth") depth = std::stoi(value);
+		else if (name == "-hash") hash = std::stoi(value);
+		else if (name == "-sym") sym = std::stoi(value);
+		else if (name == "-tss") tss = std::stoi(value);
+		else if (name == "-nodes") nodes = std::stoll(value);
+		else return false;
+		return true;
+	}
+	void apply(playerData &p) const {
+		p.depth = depth;
+		p.split = split;
+		p.mcts = mcts;
+		p.pvs = pvs;
+		p.lmr = lmr;
+		p.prune = prune;
+		p.quiescence = qs;
+		p.tt = std::make_shared<TransTable>(hash);
+		p.threatShare = tss;
+		p.symmetry = sym;
+		p.maxNodes = nodes;
+	}
+};
+
+pii search(playerData &p, int threadCount, bool isalpha, int time, bool verbose = true) {
+	auto start = std::chrono::high_resolution_clock::now();
+	// node budget: one thread and no clock, so the move does not depend on timing.
+	if (p.maxNodes) threadCount = 0, time = INT_MAX / 4;
+	int bookDepth;
+	if (p.book && p.book->probe(p.B, p.car, p.mylastmove, &p.score, &bookDepth)) {
+		p.searched = bookDepth;
+		p.nodes = 0;
+		p.pv = {p.mylastmove};
+		if (verbose) std::cout << "book move\n";
+		return p.mylastmove;
+	}
+	if (p.threatShare > 0 && threatSpaceWin(p, p.mylastmove, time / p.threatShare, 24, 10, p.maxNodes ? p.maxNodes / p.threatShare : LLONG_MAX)) {
+		p.searched = 0;
+		p.nodes = 0;
+		p.score = WIN_SCORE;
+		p.pv = {p.mylastmove};
+		if (verbose) std::cout << "threat space win\n";
+		return p.mylastmove;
+	}
+	time -= (int)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start).count();
+
+	if (p.mcts) return mctsBest(p, std::max(threadCount, 1), time);
+	if (!threadCount) return minimaxBest(p, isalpha, time);
+	if (p.split && isalpha) return ybwcBest(p, threadCount, time);
+	return minimaxBestThreading(p, isalpha, threadCount, time);
+}
+
+// pondering: while the opponent thinks, position after its predicted reply (second move of our pv)
+// is searched in background on a copy of `p`, which shares the transposition table with it.
+struct Ponder {
+	std::unique_ptr<playerData> copy;
+	pii guess = {-1, -1};
+	std::atomic<bool> halt{false};
+	std::thread worker;
+	std::chrono::time_point<std::chrono::high_resolution_clock> started;
+	// the search ended by itself (depth limit, found win, forced move), read after `join()`.
+	bool finished = false;
+
+	~Ponder() { stop(); }
+
+	void start(const playerData &p, int threadCount, bool isalpha) {
+		stop();
+		if (p.pv.size() < 2) return;
+		guess = p.pv[1];
+		if (!p.B.inBounds(guess.i, guess.j) || p.B.at(guess.i, guess.j) != E) return;
+		copy.reset(new playerData(p));
+		copy->B.make(guess, p.opp);
+		copy->mylastmove = {-1, -1};
+		// threat space search can not be interrupted.
+		copy->threatShare = 0;
+		copy->halt = &halt;
+		copy->helpers.reset();
+		halt = false;
+		finished = false;
+		started = std::chrono::high_resolution_clock::now();
+		worker = std::thread([this, threadCount, isalpha] {
+			search(*copy, threadCount, isalpha, INT_MAX / 4);
+			finished = true;
+		});
+	}
+	void stop() {
+		halt = true;
+		if (worker.joinable()) worker.join();
+	}
+	// ends pondering after opponent played `played`, true on a correct guess. `left` gets the move time (of `time`)
+	// still to search: none when the ponder search ended by itself or ran at least `time`, its move then goes
+	// to `move` and its results to `p`. else only the table (shared) and move order are warm, and the rest is searched.
+	bool finish(const pii &played, playerData &p, pii &move, int time, int &left) {
+		left = time;
+		if (!worker.joinable()) return false;
+		stop();
+		if (played.i != guess.i || played.j != guess.j) return false;
+		auto pondered = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - started).count();
+		if (!finished && pondered < time) {
+			p.order = copy->order;
+			left = time - (int)pondered;
+			return true;
+		}
+		left = 0;
+		move = p.mylastmove = copy->mylastmove;
+		p.searched = copy->searched;
+		p.nodes = copy->nodes;
+		p.score = copy->score;
+		p.pv = copy->pv;
+		p.stats = copy->stats;
+		p.order = copy->order;
+		return true;
+	}
+};
+
+// one line report of the last search of `p` (`ms` long): speed, table use, effective branching factor
+// (nodes of the last iteration over the one before), move ordering, iteration times and thread loads.
+// also written as a json line to `json` when it is open.
+void report(const playerData &p, const pii &move, long long ms, std::ofstream &json) {
+	const SearchStats &st = p.stats;
+	ms = std::max<long long>(ms, 1);
+	long long nps = p.nodes * 1000 / ms, threadTotal = 0;
+	for (long long t: st.threadNodes) threadTotal += t;
+	std::vector<long long> iterationNodes;
+	for (size_t k = 0; k < st.iterations.size(); k++) iterationNodes.push_back(st.iterations[k].second - (k ? st.iterations[k - 1].second : 0));
+	double ebf = 0;
+	if (iterationNodes.size() >= 2 && iterationNodes[iterationNodes.size() - 2] > 0) ebf = double(iterationNodes.back()) / iterationNodes[iterationNodes.size() - 2];
+	else if (p.searched > 0 && p.nodes > 1) ebf = std::pow(double(p.nodes), 1.0 / p.searched);
+	auto percent = [](long long part, long long whole) { return whole ? int(part * 100 / whole) : 0; };
+
+	std::cout << "  " << ms << " ms, " << nps / 1000 << " kn/s";
+	if (st.ttProbes) std::cout << ", tt " << percent(st.ttHits, st.ttProbes) << "% hits " << percent(st.ttCutoffs, st.ttProbes) << "% cutoffs";
+	if (ebf > 0) std::cout << ", ebf " << int(ebf * 10) / 10.0;
+	if (st.cutoffs) std::cout << ", first move cutoffs " << percent(st.firstCutoffs, st.cutoffs) << "%";
+	if (st.iterations.size()) {
+		std::cout << ", iterations (ms)";
+		for (auto &it: st.iterations) std::cout << " " << it.first;
+	}
+	if (st.threadNodes.size() > 1) {
+		std::cout << ", threads (%)";
+		for (long long t: st.threadNodes) std::cout << " " << percent(t, threadTotal);
+	}
+	std::cout << "\n";
+
+	if (!json.is_open()) return;
+	nlohmann::json line = {
+		{"player", std::string(1, p.car)}, {"move", {move.i, move.j}}, {"depth", p.searched}, {"score", p.score},
+		{"nodes", p.nodes}, {"ms", ms}, {"nps", nps}, {"mcts", p.mcts},
+		{"ttProbes", st.ttProbes}, {"ttHits", st.ttHits}, {"ttCutoffs", st.ttCutoffs},
+		{"cutoffs", st.cutoffs}, {"firstCutoffs", st.firstCutoffs}, {"ebf", ebf}, {"threadNodes", st.threadNodes}
+	};
+	line["iterations"] = nlohmann::json::array();
+	for (size_t k = 0; k < st.iterations.size(); k++) line["iterations"].push_back({{"ms", st.iterations[k].first}, {"nodes", iterationNodes[k]}});
+	json << line.dump() << "\n";
+	json.flush();
+}
 
 void online_make_move(pii &move, std::string gameid, std::string teamid = "1447") {
 	// type=move&teamId=1447&gameId={gameid}&move={i},{j}
@@ -73,26 +254,46 @@ void online_read_board(playerData &p, std::string gameid, char &current) {
 
 int main(int argc, char **argv) {
 
-	int threadCount = 0, depth = 4, n = 12, m = 6, gameid = 0, time = 28000, online = 0;
+	int n = 12, m = 6, online = 0, buildbook = 0, games = 0, parallel = std::max<int>(std::thread::hardware_concurrency(), 1);
 	char human = O, current = O;
-	bool load = false, isalpha = true, startX = false, dynamic = false;
-	std::string argument = (argc > 1) ? (argv[1]) : ("-help");
+	bool load = false, startX = false, dynamic = false, solve = false, ponder = false;
+	std::string argument = (argc > 1) ? (argv[1]) : ("-help"), bookfile, statsfile, openingsfile, versus;
+	Engine engine;
 
 	std::cout << "total arguments: " << int((argc - 1) / 2) << "\n";
 	if (argument == "-help") {
 		std::cout << "\nneed at least one argument to start like: -depth 3\n";
-		std::cout << "-n {board size. default(12)}\n";
+		std::cout << "-n {board size, up to " << MAX_N << ". default(12)}\n";
 		std::cout << "-m {win line length. default(6)}\n\n";
 		std::cout << "-threads {how many thread to use, where 0 - no threading, 1 - maximum threading, 2 - 2 threads and etc. default(0)}\n";
-		std::cout << "-depth {depth of minimax. default(4)}\n\n";
+		std::cout << "-split {1 - threads split the alpha-beta tree (young brothers wait) instead of lazy smp. default(0)}\n";
+		std::cout << "-mcts {1 - monte carlo tree search (PUCT, threads share one tree) instead of minimax, tree size from -hash. default(0)}\n";
+		std::cout << "-depth {maximum depth of iterative deepening minimax. default(4)}\n";
+		std::cout << "-hash {transposition table size in MB for each ai, kept for whole game. default(64)}\n";
+		std::cout << "-sym {1 - rotations and reflections of a position share transposition table entries. default(1)}\n";
+		std::cout << "-tss {1/x of move time for threat space search (forced wins by fours and threes) before minimax, 0 - off. default(8)}\n\n";
 		std::cout << "-player {your/oponent symbol against ai, can be X or O where O start first. default(O)}\n";
 		std::cout << "-alpha {should it use alpha-beta purning. default(1)}\n";
+		std::cout << "-pvs {1 - principal variation search (zero window for later moves, aspiration window at root), with -alpha 1. default(0)}\n";
+		std::cout << "-lmr {1 - late move reductions (late quiet moves searched shallower first), with -alpha 1. default(0)}\n";
+		std::cout << "-prune {1 - skip moves which ignore opponent four or open three, with -alpha 1. default(0)}\n";
+		std::cout << "-qs {node budget of quiescence search (fours and blocks of fours) at every horizon position, 0 - off. default(0)}\n";
+		std::cout << "-nodes {node budget of every search (playouts with -mcts), 0 - none. runs on one thread without the clock and turns -ponder off, so games repeat exactly. default(0)}\n";
 		std::cout << "-time {time limit for each step in milli seconds. default(30000)}\n";
 		std::cout << "-start {1 - start with X instead, useful with -load. default(0)}\n";
-		std::cout << "-dynamic {1 - change depth depending on time limit. default(0)}\n";
+		std::cout << "-ponder {1 - keep searching the predicted opponent reply during its turn. default(0)}\n";
+		std::cout << "-stats {file - append search statistics of every move there as json lines}\n";
+		std::cout << "-dynamic {1 - no depth limit, iterative deepening goes on until the time limit. default(0)}\n";
 		std::cout << "-online {gameId - for ai making auto request. Disables player input (reads from api). default(0)}\n";
 		std::cout << "-teamid {useful for online. default(1447)}\n";
-		std::cout << "-load {should it load game board from map.txt. default(0)}\n\n";
+		std::cout << "-load {should it load game board from map.txt. default(0)}\n";
+		std::cout << "-book {opening book file, replies found there are played without search}\n";
+		std::cout << "-buildbook {plies - search every opening (map.txt with -load) up to that many moves deep and write the -book file (default book.bin), uses -threads, -time and -depth. default(0)}\n";
+		std::cout << "-games {count - headless tournament of this ai (A) against -vs one (B) instead of a game, results with elo. default(0)}\n";
+		std::cout << "-vs {\"options\" - engine options of B which differ from A, like \"-depth 6 -lmr 1\"}\n";
+		std::cout << "-openings {file - tournament openings, one per line as \"i,j i,j ..\" from O; written there with generated ones if missing}\n";
+		std::cout << "-parallel {tournament games played at once. default(cores)}\n";
+		std::cout << "-solve {1 - prove map.txt position won or lost for side to move (proof number search), uses -threads, -time and -hash. default(0)}\n\n";
 		std::cout << "Here is example of map.txt:\n";
 		std::cout << "XX----------\n";
 		std::cout << "------------\n";
@@ -113,31 +314,50 @@ int main(int argc, char **argv) {
 	for (int i = 1; i < argc; i += 2) {
 		std::string argument = argv[i];
 		std::cout << argument << " " << argv[i + 1] << "\n";
+		if (engine.set(argument, argv[i + 1])) continue;
 		if (argument == "-load") load = std::stoi(argv[i + 1]);
 		else if (argument == "-n") n = std::stoi(argv[i + 1]);
 		else if (argument == "-m") m = std::stoi(argv[i + 1]);
-		else if (argument == "-threads") threadCount = std::stoi(argv[i + 1]);
 		else if (argument == "-online") online = std::stoi(argv[i + 1]);
-		else if (argument == "-time") time = std::stoi(argv[i + 1]);
-		else if (argument == "-alpha") isalpha = std::stoi(argv[i + 1]);
-		else if (argument == "-depth") depth = std::stoi(argv[i + 1]);
 		else if (argument == "-start") startX = std::stoi(argv[i + 1]);
+		else if (argument == "-ponder") ponder = std::stoi(argv[i + 1]);
 		else if (argument == "-dynamic") dynamic = std::stoi(argv[i + 1]);
 		else if (argument == "-player") human = argv[i + 1][0];
+		else if (argument == "-book") bookfile = argv[i + 1];
+		else if (argument == "-stats") statsfile = argv[i + 1];
+		else if (argument == "-buildbook") buildbook = std::stoi(argv[i + 1]);
+		else if (argument == "-games") games = std::stoi(argv[i + 1]);
+		else if (argument == "-vs") versus = argv[i + 1];
+		else if (argument == "-openings") openingsfile = argv[i + 1];
+		else if (argument == "-parallel") parallel = std::stoi(argv[i + 1]);
+		else if (argument == "-solve") solve = load = std::stoi(argv[i + 1]);
 		else {
 			std::cout << "Error with param:{" << argument << "}\n";
 			return -1;
 		}
 	}
 
+	if (n > MAX_N) n = MAX_N;
 	if (m > n) m = n;
 	if (human != X && human != O) human = X;
-	if (threadCount == 1) threadCount = std::thread::hardware_concurrency() - 1;
+	Engine other = engine;
+	std::istringstream options(versus);
+	for (std::string name, value; options >> name;) {
+		if (!(options >> value) || !other.set(name, value)) {
+			std::cout << "Error with -vs param:{" << name << "}\n";
+			return -1;
+		}
+	}
+	for (Engine *e: {&engine, &other}) {
+		if (e->threads == 1) e->threads = std::thread::hardware_concurrency() - 1;
+	}
+	const int threadCount = engine.threads, time = engine.time;
+	const bool isalpha = engine.isalpha;
 
 	playerData p1{Board(n, m)};
 	p1.opp = human;
 	p1.car = human == X ? O : X;
-	p1.depth = depth;
+	engine.apply(p1);
 
 	if (load) {
 		std::cout << "reading..\n";
@@ -170,31 +390,119 @@ int main(int argc, char **argv) {
 	}
 	if (current == X) startX = true;
 
-	play_inconsole2(p1, threadCount, n, m, isalpha, time, online, startX, dynamic);
+	if (solve && !p1.B.pattern) {
+		std::cout << "-solve needs win length up to " << MAX_PATTERN_M << "\n";
+		return -1;
+	}
+	if (solve) {
+		// O starts, so it is to move when stones are even.
+		int xs = 0, os = 0;
+		for (int i = 0; i < n; i++) for (int j = 0; j < n; j++) xs += p1.B.at(i, j) == X, os += p1.B.at(i, j) == O;
+		char tomove = os > xs ? X : O;
+		std::cout << p1.B.display() << "solving for " << tomove << " to move..\n";
+		auto start = std::chrono::high_resolution_clock::now();
+		ProofResult result = solvePosition(p1.B, tomove, std::max(threadCount, 1), time, engine.hash);
+		auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start).count();
+		const char *names[] = {"unknown (limit reached)", "win", "loss", "no win found (frontier moves only)"};
+		std::cout << tomove << ": " << names[result.value];
+		if (result.move.i != -1) std::cout << ", move " << result.move.i << " : " << result.move.j;
+		std::cout << " (" << result.nodes << " nodes, " << elapsed << " ms)\n";
+		return 0;
+	}
+
+	if (buildbook) {
+		if (bookfile.empty()) bookfile = "book.bin";
+		char first = startX ? X : O, second = first == X ? O : X;
+		int firsts = 0, seconds = 0;
+		for (int i = 0; i < n; i++) for (int j = 0; j < n; j++) firsts += p1.B.at(i, j) == first, seconds += p1.B.at(i, j) == second;
+		auto start = std::chrono::high_resolution_clock::now();
+		std::vector<BookEntry> entries = buildBook(p1, firsts > seconds ? second : first, buildbook,
+			[&](playerData &q) { return search(q, threadCount, isalpha, time); });
+		auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start).count();
+		if (!writeBook(bookfile, n, m, entries)) {
+			std::cout << "can not write " << bookfile << "\n";
+			return -1;
+		}
+		std::cout << entries.size() << " positions written to " << bookfile << " (" << elapsed << " ms)\n";
+		return 0;
+	}
+	if (!bookfile.empty()) {
+		std::shared_ptr<OpeningBook> book = std::make_shared<OpeningBook>();
+		if (book->open(bookfile) && book->n == n && book->m == m) {
+			std::cout << "book: " << book->count << " positions\n";
+			p1.book = book;
+		}
+		else std::cout << "book " << bookfile << " not loaded (missing, or made for other -n/-m)\n";
+	}
+
+	if (games > 0) {
+		std::vector<Opening> openings;
+		if (!openingsfile.empty()) openings = readOpenings(openingsfile, n);
+		if (openings.empty()) {
+			openings = generateOpenings(n, m, std::max(games / 2, 1), 4, 1);
+			if (!openingsfile.empty() && writeOpenings(openingsfile, openings)) std::cout << "openings written to " << openingsfile << "\n";
+		}
+		playerData p2 = p1;
+		other.apply(p2);
+		const Engine engines[2] = {engine, other};
+		std::cout << "tournament: " << games << " games, " << openings.size() << " openings, " << parallel << " at a time\n";
+		TournamentResult result = runTournament(p1, p2, openings, games, parallel,
+			[&engines](playerData &q, int e) { return search(q, engines[e].threads, engines[e].isalpha, engines[e].time, false); });
+
+		double elo, error;
+		result.elo(elo, error);
+		std::cout << "\nA: +" << result.wins << " =" << result.draws << " -" << result.losses << " of " << result.games()
+			<< " (score " << int(result.score() * 1000) / 10.0 << "%), elo difference " << int(elo) << " +/- " << int(error) << "\n";
+		for (int e = 0; e < 2; e++) {
+			const EngineTally &t = result.engines[e];
+			std::cout << (e ? "B" : "A") << ": " << t.moves << " searched moves, " << (t.nodes * 1000 / std::max(t.ms, 1LL)) / 1000 << " kn/s, average depth "
+				<< (t.moves ? int(t.depth * 10 / t.moves) / 10.0 : 0) << "\n";
+		}
+		return 0;
+	}
+
+	play_inconsole2(p1, threadCount, n, m, isalpha, time, online, startX, dynamic, ponder, statsfile);
 
 	return 0;
 }
 
 void play_inconsole2(playerData &p, int threadCount, int n, int m,
-		bool isalpha, int time, int online, bool startX, bool dynamic) {
+		bool isalpha, int time, int online, bool startX, bool dynamic, bool ponder, const std::string &statsfile) {
+	if (dynamic) p.depth = MAX_DEPTH;
+	// pondering fills the table for as long as the opponent thinks, node budget games would not repeat.
+	if (ponder && p.maxNodes) {
+		std::cout << "-ponder is off with -nodes\n";
+		ponder = false;
+	}
 	std::cout << "\n AI(" << p.car << "); depth: " << p.depth << "; win length: " << m << ";";
-	if (isalpha) std::cout << " +alpha-beta;";
-	if (threadCount) std::cout << " threads: " << threadCount << ";";
+	if (p.mcts) std::cout << " +mcts;";
+	else if (isalpha) std::cout << " +alpha-beta;";
+	if (isalpha && p.pvs) std::cout << " +pvs;";
+	if (isalpha && p.lmr) std::cout << " +lmr;";
+	if (isalpha && p.prune) std::cout << " +prune;";
+	if (p.quiescence) std::cout << " quiescence: " << p.quiescence << ";";
+	if (threadCount) std::cout << " threads: " << threadCount << (p.split ? " (split)" : "") << ";";
+	if (ponder) std::cout << " +ponder;";
 	std::cout << "\n";
 
 	std::string input, gameid = std::to_string(online);
 	char current = startX ? X : O;
 	bool istie = false;
-	int localdepth = p.depth;
 	pii move;
+	Ponder pondering;
+	std::ofstream json;
+	if (!statsfile.empty()) json.open(statsfile, std::ios::app);
 
-	playerData p2{p.B};
+	playerData p2 = p;
+	p2.tt = std::make_shared<TransTable>(p.tt->megabytes());
+	p2.helpers.reset();
 	p2.car = p.opp;
 	p2.opp = p.car;
-	p2.depth = p.depth;
+	p2.mylastmove = {-1, -1};
 
 	do {
 		std::cout << p.B.display();
+		auto moveStart = std::chrono::high_resolution_clock::now();
 
 		if (online && current == p.opp) {
 			// std::cout << "Send move?";
@@ -209,35 +517,41 @@ void play_inconsole2(playerData &p, int threadCount, int n, int m,
 			// do {
 			// 	std::cout << "Player " << current << ", enter your move (row col, index starts from 0): ";
 			// 	std::cin >> move.i >> move.j;
-			// } while (move.i < 0 || move.i >= n || move.j < 0 || move.j >= n || p.B.g[move.i][move.j] != E);
+			// } while (move.i < 0 || move.i >= n || move.j < 0 || move.j >= n || p.B.at(move.i, move.j) != E);
 			std::cout << "AI2 (" << current << ")'s turn...\n";
-			if (threadCount) move = minimaxBestThreading(p2, isalpha, threadCount, time);
-			else move = minimaxBest(p2, isalpha, time);
+			move = search(p2, threadCount, isalpha, time);
 		} else {
 			std::cout << "AI (" << current << ")'s turn...\n";
-			if (threadCount) move = minimaxBestThreading(p, isalpha, threadCount, time);
-			else move = minimaxBest(p, isalpha, time);
+			int left;
+			if (pondering.finish(p.B.lastmove, p, move, time, left)) std::cout << "ponder hit" << (left ? ", searching on\n" : "\n");
+			if (left) move = search(p, threadCount, isalpha, left);
 			if (online) online_make_move(move, gameid);
 		}
 
-		std::cout << move.i << " : " << move.j << " (depth: " << p.depth << ")\n";
-		if (!dynamic) p.depth = localdepth;
+		playerData &mover = current == p.car ? p : p2;
+		if (mover.mcts) {
+			auto ms = std::max<long long>(1, std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - moveStart).count());
+			std::cout << move.i << " : " << move.j << " (depth: " << mover.searched << ", playouts: " << mover.nodes << ", " << mover.nodes * 1000 / ms << "/s)\n";
+		}
+		else std::cout << move.i << " : " << move.j << " (depth: " << mover.searched << ", nodes: " << mover.nodes << ")\n";
+		if (!(online && current == p.opp) && mover.nodes) {
+			report(mover, move, std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - moveStart).count(), json);
+		}
 		p.B.make(move, current);
-		current = (current == X ? O : X);
-
-		if (!dynamic) p2.depth = localdepth;
 		p2.B.make(move, current);
+		if (ponder && current == p.car) pondering.start(p, threadCount, isalpha);
+		current = (current == X ? O : X);
 
 		if (p.B.full()) istie = true;
 	} while (!istie && !p.B.isMoveWin(move));
 
 	if (p.B.isMoveWin(move)) {
-		std::cout << p.B.g[move.i][move.j] << " is winner.\n";
+		std::cout << p.B.at(move.i, move.j) << " is winner.\n";
 	}
 	else std::cout << " game is tie.\n";
-	for (auto &row : p.B.g) {
-		for (auto c : row)
-			std::cout << c << " ";
+	for (int i = 0; i < p.B.n; i++) {
+		for (int j = 0; j < p.B.n; j++)
+			std::cout << p.B.at(i, j) << " ";
 		std::cout << "\n";
 	}
 	std::cout << '\n';